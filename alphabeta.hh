@@ -0,0 +1,331 @@
+#ifndef ALPHABETA_HH
+#define ALPHABETA_HH
+
+#include <map>
+#include <optional>
+#include <set>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <atomic>
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
+#include <tbb/spin_mutex.h>
+#include <tbb/enumerable_thread_specific.h>
+#include "boarddata.hh"
+#include "state.hh"
+#include "strategies.hh"
+#include "transposition.hh"
+#include "ordering.hh"
+
+// Moves of the proving side, keyed by position. The other side may play
+// any move, so its moves are not stored, but every position it can reach
+// with a live cell left has an entry.
+using ProvingStrategy = map<pair<Zobrist, Signature>, Position>;
+
+// Alpha-beta negamax solver over the three game values, scored from the side
+// to move: 1 is a win, 0 a draw and -1 a loss. The search deepens one ply at
+// a time, reusing the best moves of the transposition table for ordering. A
+// draw reached through the horizon is only a guess, but a win or a loss
+// never depends on it, so the search stops at the first iteration that
+// returns a win or a loss, or a draw that never touched the horizon.
+//
+// With more than one thread the search splits Young Brothers Wait style:
+// the first child of a node is searched alone, and only when it does not
+// cut off are the other children spawned as tasks. A cutoff in any of them
+// cancels the rest: running tasks notice it before each move, and cancelled
+// searches leave the table untouched. This solver only returns the value;
+// MiniMax with the ParallelDFS traversal splits the same way while building
+// a SolutionTree.
+template<int N, int D>
+class AlphaBeta {
+ public:
+  constexpr static Position board_size = BoardData<N, D>::board_size;
+
+  explicit AlphaBeta(const BoardData<N, D>& data, size_t transposition_bytes = 16 << 20)
+      : data(data), transposition(transposition_bytes), ordering(MoveOrdering<N, D>(data)) {
+  }
+
+  void set_threads(int count) {
+    threads = count;
+  }
+
+  int get_threads() const {
+    return threads;
+  }
+
+  BoardValue solve(const State<N, D>& state, Turn turn) {
+    auto [score, solved_depth] = deepen(state, turn);
+    return to_value(score, turn);
+  }
+
+  // The moves that keep the solved value for the side it favors, against
+  // every reply of the other side, symmetric ones included. Nothing is
+  // returned if some position of the prover has no such move, which means
+  // the table no longer holds the value that was solved.
+  optional<ProvingStrategy> extract_strategy(const State<N, D>& state, Turn turn) {
+    auto [score, solved_depth] = deepen(state, turn);
+    auto value = to_value(score, turn);
+    Turn prover = value == BoardValue::X_WIN ? Turn::X : Turn::O;
+    int target = value == BoardValue::DRAW ? 0 : 1;
+    ProvingStrategy strategy;
+    set<pair<Zobrist, Signature>> visited;
+    if (!extract(state, turn, prover, target, solved_depth, strategy, visited)) {
+      return {};
+    }
+    return strategy;
+  }
+
+  int get_depth() const {
+    return depth;
+  }
+
+  size_t memory_bytes() const {
+    return transposition.memory_bytes();
+  }
+
+  atomic<int> nodes_visited = 0;
+
+ private:
+  enum Bound : uint32_t {
+    EXACT = 0,
+    LOWER = 1,
+    UPPER = 2
+  };
+  // Entries hold the score plus one, the bound, whether the bound holds at
+  // any depth, the remaining depth and the best move.
+  struct Entry {
+    int score;
+    Bound bound;
+    bool proven;
+    int depth;
+    Position move;
+  };
+  constexpr static Position no_move = Position{255};
+  // Subtrees closer to the horizon than this are not worth a task.
+  constexpr static int min_split_depth = 4;
+
+  const BoardData<N, D>& data;
+  TranspositionTable transposition;
+  tbb::enumerable_thread_specific<MoveOrdering<N, D>> ordering;
+  int threads = 1;
+  int depth = 0;
+
+  // Iterative deepening, returning the score and the depth it was found at.
+  pair<int, int> deepen(const State<N, D>& state, Turn turn) {
+    int score = 0;
+    int limit = 1;
+    tbb::task_arena arena(threads);
+    arena.execute([&]() {
+      for (; limit <= board_size; limit++) {
+        bool horizon = false;
+        score = search(state, turn, limit, -1, 1, 1, horizon);
+        if (score != 0 || !horizon) {
+          break;
+        }
+      }
+    });
+    limit = min(limit, static_cast<int>(board_size));
+    depth = limit;
+    return {score, limit};
+  }
+
+  static BoardValue to_value(int score, Turn turn) {
+    if (score == 0) {
+      return BoardValue::DRAW;
+    }
+    return (score > 0) == (turn == Turn::X) ? BoardValue::X_WIN : BoardValue::O_WIN;
+  }
+
+  static TranspositionKey key_of(const State<N, D>& state) {
+    return TranspositionKey{state.get_zobrist(), state.get_signature()};
+  }
+
+  static uint32_t pack(const Entry& entry) {
+    return static_cast<uint32_t>(entry.score + 1) | (static_cast<uint32_t>(entry.bound) << 2) |
+        (static_cast<uint32_t>(entry.proven) << 4) | (static_cast<uint32_t>(entry.depth) << 5) |
+        (static_cast<uint32_t>(entry.move) << 13);
+  }
+
+  static Entry unpack(uint32_t packed) {
+    return Entry{static_cast<int>(packed & 3) - 1, static_cast<Bound>((packed >> 2) & 3),
+        ((packed >> 4) & 1) != 0, static_cast<int>((packed >> 5) & 0xFF),
+        Position{static_cast<int>((packed >> 13) & 0xFF)}};
+  }
+
+  // The moves worth trying, best first, or a single move when one side has
+  // a line to complete. The flag tells whether the side to move wins at once.
+  pair<bag<Position>, bool> get_moves(const State<N, D>& state, Turn turn, int ply, Position hint) {
+    const auto& ordering = this->ordering.local();
+    bag<Position> moves;
+    auto open_positions = state.get_open_positions(to_mark(turn));
+    auto forcing = ForcingMove<N, D>(state).check(to_mark(turn), open_positions);
+    if (forcing.first.has_value()) {
+      moves.push_back(*forcing.first);
+      return {moves, forcing.second == to_mark(turn)};
+    }
+    vector<pair<typename MoveOrdering<N, D>::Score, Position>> scored;
+    for (auto pos : open_positions) {
+      scored.emplace_back(ordering.score(state, turn, ply, pos, state.get_current_accumulation(pos)), pos);
+    }
+    sort(begin(scored), end(scored), [](const auto& a, const auto& b) {
+      return a.first > b.first;
+    });
+    for (const auto& [score, pos] : scored) {
+      moves.push_back(pos);
+    }
+    auto it = find(begin(moves), end(moves), hint);
+    if (it != end(moves)) {
+      rotate(begin(moves), it, it + 1);
+    }
+    return {moves, false};
+  }
+
+  // Sets the horizon flag when the score depends on the depth limit.
+  int search(const State<N, D>& state, Turn turn, int remaining, int alpha, int beta, int ply,
+             bool& horizon) {
+    nodes_visited.fetch_add(1, memory_order_relaxed);
+    auto key = key_of(state);
+    Position hint = no_move;
+    if (auto packed = transposition.find(key); packed.has_value()) {
+      auto entry = unpack(*packed);
+      hint = entry.move;
+      if (entry.proven || entry.depth >= remaining) {
+        bool cut = entry.bound == EXACT ||
+            (entry.bound == LOWER && entry.score >= beta) ||
+            (entry.bound == UPPER && entry.score <= alpha);
+        if (cut) {
+          horizon |= !entry.proven;
+          return entry.score;
+        }
+      }
+    }
+    auto [moves, wins] = get_moves(state, turn, ply, hint);
+    if (wins) {
+      return 1;
+    }
+    if (moves.empty()) {
+      return 0;
+    }
+    if (remaining == 0) {
+      horizon = true;
+      return 0;
+    }
+    bool below = false;
+    int original_alpha = alpha;
+    int best = -2;
+    Position best_move = no_move;
+    auto visit = [&](Position pos, int child_alpha, bool& child_horizon) {
+      State<N, D> child = state;
+      return child.play(pos, to_mark(turn)) ? 1 :
+          -search(child, flip(turn), remaining - 1, -beta, -child_alpha, ply + 1, child_horizon);
+    };
+    for (size_t i = 0; i < moves.size(); i++) {
+      if (threads > 1 && tbb::is_current_task_group_canceling()) {
+        break;
+      }
+      if (i == 1 && threads > 1 && remaining >= min_split_depth) {
+        split(moves, visit, alpha, beta, best, best_move, below);
+        break;
+      }
+      int score = visit(moves[i], alpha, below);
+      if (score > best) {
+        best = score;
+        best_move = moves[i];
+      }
+      alpha = max(alpha, score);
+      if (alpha >= beta) {
+        break;
+      }
+    }
+    if (threads > 1 && tbb::is_current_task_group_canceling()) {
+      horizon = true;
+      return 0;
+    }
+    if (best >= beta) {
+      ordering.local().reward(turn, ply, best_move);
+    }
+    Bound bound = best <= original_alpha ? UPPER : best >= beta ? LOWER : EXACT;
+    bool proven = !below || (best == 1 && bound != UPPER) || (best == -1 && bound != LOWER);
+    auto priority = static_cast<uint16_t>(proven ? board_size + 1 : remaining);
+    transposition.store(key, pack(Entry{best, bound, proven, remaining, best_move}), priority);
+    horizon |= !proven;
+    return best;
+  }
+
+  // Searches the younger brothers as tasks, after the eldest failed to cut.
+  template<typename Visit>
+  void split(const bag<Position>& moves, Visit& visit, int& alpha, int beta, int& best,
+             Position& best_move, bool& below) {
+    tbb::task_group group;
+    tbb::spin_mutex mutex;
+    for (size_t i = 1; i < moves.size(); i++) {
+      group.run([&, pos = moves[i]]() {
+        int child_alpha;
+        {
+          tbb::spin_mutex::scoped_lock lock(mutex);
+          child_alpha = alpha;
+        }
+        bool child_horizon = false;
+        int score = visit(pos, child_alpha, child_horizon);
+        if (tbb::is_current_task_group_canceling()) {
+          return;
+        }
+        tbb::spin_mutex::scoped_lock lock(mutex);
+        below |= child_horizon;
+        if (score > best) {
+          best = score;
+          best_move = pos;
+        }
+        alpha = max(alpha, score);
+        if (alpha >= beta) {
+          group.cancel();
+        }
+      });
+    }
+    group.wait();
+  }
+
+  // Positions reached through transpositions are only walked once. A win
+  // is kept within the remaining plies of the deepening that found it, or
+  // weak replies of the other side would stretch the strategy without end.
+  // The replies are the live cells, symmetric ones included; State never
+  // plays a dead cell, where no line can be completed any more.
+  bool extract(const State<N, D>& state, Turn turn, Turn prover, int target, int remaining,
+               ProvingStrategy& strategy, set<pair<Zobrist, Signature>>& visited) {
+    pair<Zobrist, Signature> key{state.get_zobrist(), state.get_signature()};
+    if (!visited.insert(key).second) {
+      return true;
+    }
+    if (turn != prover) {
+      // The solved value rules out a reply that wins.
+      for (Position pos : state.get_live_cells()) {
+        State<N, D> child = state;
+        if (child.play(pos, to_mark(turn))
+            || !extract(child, flip(turn), prover, target, remaining - 1, strategy, visited)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    auto [moves, wins] = get_moves(state, turn, 1, no_move);
+    for (auto pos : moves) {
+      State<N, D> child = state;
+      if (child.play(pos, to_mark(turn))) {
+        strategy[key] = pos;
+        return true;
+      }
+      bool horizon = false;
+      int limit = target > 0 ? remaining - 1 : board_size;
+      if (-search(child, flip(turn), limit, -1, 1, 2, horizon) >= target) {
+        strategy[key] = pos;
+        return extract(child, flip(turn), prover, target, remaining - 1, strategy, visited);
+      }
+    }
+    // A draw with the board full, or a prover position with no move that
+    // keeps the value.
+    return moves.empty();
+  }
+};
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef ARENA_HH
+#define ARENA_HH
+
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <algorithm>
+
+// Growable arena with stable addresses. Elements are addressed by 32-bit
+// handles and stored in chunks that are allocated on demand. Each chunk is
+// aligned to its own size and starts with a header, so the arena owning an
+// element and the element's handle are found by masking its address.
+template<typename T>
+class ChunkedArena {
+ public:
+  using Handle = uint32_t;
+  constexpr static size_t chunk_bytes = 1 << 20;
+
+  explicit ChunkedArena(size_t budget) : budget(budget) {
+  }
+
+  ChunkedArena(const ChunkedArena&) = delete;
+  ChunkedArena& operator=(const ChunkedArena&) = delete;
+
+  ~ChunkedArena() {
+    truncate(0);
+    for (auto chunk : chunks) {
+      free(chunk);
+    }
+  }
+
+  template<typename... Args>
+  T *emplace_back(Args&&... args) {
+    if (count == chunks.size() * chunk_size) {
+      auto chunk = static_cast<Header *>(aligned_alloc(chunk_bytes, chunk_bytes));
+      if (chunk == nullptr) {
+        throw std::bad_alloc();
+      }
+      chunk->arena = this;
+      chunk->first = count;
+      chunks.push_back(chunk);
+    }
+    T *element = slot(count);
+    new (element) T(std::forward<Args>(args)...);
+    count++;
+    return element;
+  }
+
+  // Destroys the elements from the given handle on. The chunks are kept
+  // for the elements created afterwards.
+  void truncate(Handle size) {
+    for (Handle handle = size; handle < count; handle++) {
+      slot(handle)->~T();
+    }
+    count = std::min(count, size);
+  }
+
+  T& operator[](Handle handle) {
+    return *slot(handle);
+  }
+
+  const T& operator[](Handle handle) const {
+    return *slot(handle);
+  }
+
+  Handle size() const {
+    return count;
+  }
+
+  size_t get_budget() const {
+    return budget;
+  }
+
+  void set_budget(size_t size) {
+    budget = size;
+  }
+
+  bool is_full() const {
+    return count >= budget;
+  }
+
+  // Sizes the chunk table for the whole budget, so threads that read the
+  // arena never see the table move while another thread grows it.
+  void reserve() {
+    chunks.reserve(budget / chunk_size + 2);
+  }
+
+  size_t memory_bytes() const {
+    return chunks.size() * chunk_bytes;
+  }
+
+  static Handle handle_of(const T *element) {
+    auto chunk = header_of(element);
+    return chunk->first + static_cast<Handle>(element - elements(chunk));
+  }
+
+  static ChunkedArena *arena_of(const T *element) {
+    return header_of(element)->arena;
+  }
+
+ private:
+  struct Header {
+    ChunkedArena *arena;
+    Handle first;
+  };
+  constexpr static size_t header_bytes = (sizeof(Header) + alignof(T) - 1) / alignof(T) * alignof(T);
+  constexpr static Handle chunk_size = (chunk_bytes - header_bytes) / sizeof(T);
+
+  std::vector<Header *> chunks;
+  Handle count = 0;
+  size_t budget;
+
+  static Header *header_of(const T *element) {
+    return reinterpret_cast<Header *>(reinterpret_cast<uintptr_t>(element) & ~(chunk_bytes - 1));
+  }
+
+  static T *elements(const Header *chunk) {
+    return reinterpret_cast<T *>(reinterpret_cast<uintptr_t>(chunk) + header_bytes);
+  }
+
+  T *slot(Handle handle) const {
+    return elements(chunks[handle / chunk_size]) + handle % chunk_size;
+  }
+};
+
+#endif
@@ -0,0 +1,186 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <memory>
+#include "boarddata.hh"
+#include "state.hh"
+#include "elevator.hh"
+#include "tracking.hh"
+#include "strategies.hh"
+
+// Microbenchmarks of the board primitives, printed as JSON so the results
+// of two commits can be compared. Every primitive runs on the same corpus
+// of positions, reached by random games from a fixed seed.
+
+constexpr int corpus_size = 256;
+constexpr double min_seconds = 0.2;
+
+// Keeps the compiler from dropping the work that built the value.
+template<typename T>
+void keep(const T& value) {
+  asm volatile("" : : "r"(&value) : "memory");
+}
+
+struct Result {
+  string name, board;
+  double ns_per_op;
+  uint64_t ops;
+};
+
+// Repeats the body until it ran for min_seconds. The body returns how many
+// operations it did.
+template<typename F>
+pair<double, uint64_t> measure(F body) {
+  uint64_t ops = 0;
+  auto start = chrono::steady_clock::now();
+  chrono::duration<double> elapsed{0};
+  while (elapsed.count() < min_seconds) {
+    ops += body();
+    elapsed = chrono::steady_clock::now() - start;
+  }
+  return {elapsed.count() * 1e9 / ops, ops};
+}
+
+template<int N, int D>
+vector<State<N, D>> make_corpus(const BoardData<N, D>& data) {
+  constexpr Position board_size = BoardData<N, D>::board_size;
+  mt19937 rng(12345);
+  vector<State<N, D>> corpus;
+  while (static_cast<int>(corpus.size()) < corpus_size) {
+    State<N, D> state(data);
+    int moves = rng() % (board_size / 2 + 1);
+    bool valid = true;
+    Mark mark = Mark::X;
+    for (int i = 0; i < moves && valid; i++) {
+      auto open = state.get_open_positions(mark).get_vector();
+      if (open.empty()) {
+        break;
+      }
+      valid = !state.play(open[rng() % open.size()], mark);
+      mark = flip(mark);
+    }
+    if (valid) {
+      corpus.push_back(state);
+    }
+  }
+  return corpus;
+}
+
+template<int N, int D>
+void bench_board(vector<Result>& results) {
+  constexpr Position board_size = BoardData<N, D>::board_size;
+  constexpr Line line_size = BoardData<N, D>::line_size;
+  string board = to_string(N) + "^" + to_string(D);
+  auto add = [&](string name, pair<double, uint64_t> measured) {
+    results.push_back(Result{name, board, measured.first, measured.second});
+  };
+  add("board_data", measure([]() {
+    auto data = make_unique<BoardData<N, D>>();
+    keep(data->lines_through_position()[0_pos].size());
+    return 1;
+  }));
+  auto data = make_unique<BoardData<N, D>>();
+  auto corpus = make_corpus(*data);
+  vector<Position> next_move;
+  for (const auto& state : corpus) {
+    auto open = state.get_open_positions(Mark::X);
+    next_move.push_back(open.none() ? Position{board_size} : *open.all().begin());
+  }
+  add("state_copy", measure([&]() {
+    for (const auto& state : corpus) {
+      State<N, D> copy = state;
+      keep(copy);
+    }
+    return corpus.size();
+  }));
+  add("state_copy_play", measure([&]() {
+    for (int i = 0; i < corpus_size; i++) {
+      State<N, D> copy = corpus[i];
+      if (next_move[i] != board_size) {
+        keep(copy.play(next_move[i], Mark::X));
+      }
+    }
+    return corpus.size();
+  }));
+  add("get_open_positions", measure([&]() {
+    for (const auto& state : corpus) {
+      keep(state.get_open_positions(Mark::X).count());
+    }
+    return corpus.size();
+  }));
+  // Each line goes up a floor and back down, so the floors never overflow.
+  Elevator<N, D> elevator;
+  add("elevator_increment", measure([&]() {
+    for (Line line = 0_line; line < line_size; ++line) {
+      keep(elevator[line] += Mark::X);
+      keep(elevator[line] -= Mark::X);
+    }
+    return 2 * line_size;
+  }));
+  add("elevator_iterate", measure([&]() {
+    uint64_t lines = 0;
+    for (const auto& state : corpus) {
+      for (MarkCount count = 0_mcount; count <= N; ++count) {
+        for (Mark mark : {Mark::empty, Mark::X, Mark::O}) {
+          for ([[maybe_unused]] Line line : state.get_line_marks(count, mark)) {
+            lines++;
+          }
+        }
+      }
+    }
+    keep(lines);
+    return lines;
+  }));
+  // The copy of the list is part of the cost, spread over its removals.
+  TrackingList<N, D> tracking;
+  add("tracking_remove", measure([&]() {
+    TrackingList<N, D> copy = tracking;
+    for (Position pos = 0_pos; pos < board_size; ++pos) {
+      copy.remove(pos);
+    }
+    keep(copy);
+    return board_size;
+  }));
+  add("forcing_move_check", measure([&]() {
+    for (const auto& state : corpus) {
+      auto open = state.get_open_positions(Mark::X);
+      keep(ForcingMove<N, D>(state).check(Mark::X, open).first.value_or(0_pos));
+    }
+    return corpus.size();
+  }));
+  add("forcing_strategy", measure([&]() {
+    for (const auto& state : corpus) {
+      auto open = state.get_open_positions(Mark::X);
+      keep(ForcingStrategy<N, D>(state, *data)(Mark::X, open).value_or(0_pos));
+    }
+    return corpus.size();
+  }));
+  add("chaining_search", measure([&]() {
+    for (const auto& state : corpus) {
+      keep(ChainingStrategy<N, D>(state).search(Mark::X).value_or(0_pos));
+    }
+    return corpus.size();
+  }));
+}
+
+void print_json(const vector<Result>& results) {
+  cout << "{\n  \"benchmarks\": [\n";
+  for (size_t i = 0; i < results.size(); i++) {
+    const auto& result = results[i];
+    cout << "    {\"name\": \"" << result.name << "\", \"board\": \"" << result.board
+         << "\", \"ns_per_op\": " << fixed << setprecision(2) << result.ns_per_op
+         << ", \"ops\": " << result.ops << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  cout << "  ]\n}\n";
+}
+
+int main() {
+  vector<Result> results;
+  bench_board<3, 2>(results);
+  bench_board<3, 3>(results);
+  bench_board<4, 3>(results);
+  bench_board<5, 3>(results);
+  print_json(results);
+  return 0;
+}
@@ -61,6 +61,21 @@ constexpr T factorial(T a) {
   return ans;
 }
 
+// Bytes a value holds on the heap, following nested vectors.
+template<typename T>
+size_t heap_bytes(const T& value) {
+  return 0;
+}
+
+template<typename T>
+size_t heap_bytes(const vector<T>& values) {
+  size_t bytes = values.capacity() * sizeof(T);
+  for (const auto& value : values) {
+    bytes += heap_bytes(value);
+  }
+  return bytes;
+}
+
 enum class Mark {
   empty = 0,
   X = 1,
@@ -152,6 +167,7 @@ Turn flip(Turn turn) {
 }
 
 using Zobrist = uint64_t;
+using Signature = uint32_t;
 
 template<int N, int D>
 class Geometry {
@@ -201,6 +217,14 @@ class Geometry {
     return _crossings;
   }
 
+  size_t memory_bytes() const {
+    size_t bytes = sizeof(*this) + heap_bytes(unique_terrains) + heap_bytes(_lines_through_position);
+    for (const auto& crossings : _crossings) {
+      bytes += heap_bytes(crossings);
+    }
+    return bytes;
+  }
+
   const auto& zobrist_x() const {
     return _zobrist_x;
   }
@@ -209,6 +233,14 @@ class Geometry {
     return _zobrist_o;
   }
 
+  const auto& signature_x() const {
+    return _signature_x;
+  }
+
+  const auto& signature_o() const {
+    return _signature_o;
+  }
+
   SideArray decode(Position pos) const {
     SideArray ans;
     for (Dim i = 0_dim; i < D; ++i) {
@@ -429,6 +461,8 @@ class Geometry {
     assert(numeric_limits<Zobrist>::max() <= dist.max());
     construct_zobrist_array(dist, _zobrist_x);
     construct_zobrist_array(dist, _zobrist_o);
+    construct_zobrist_array(dist, _signature_x);
+    construct_zobrist_array(dist, _signature_o);
   }
 
   template<typename Array, typename Dist>
@@ -445,6 +479,7 @@ class Geometry {
   sarray<Line, Position, line_size> _xor_table;
   sarray<Position, vector<pair<Line, Line>>, board_size> _crossings;
   sarray<Position, Zobrist, board_size> _zobrist_x, _zobrist_o;
+  sarray<Position, Signature, board_size> _signature_x, _signature_o;
   Line current_winning;
   default_random_engine zobrist_generator;
 };
@@ -559,6 +594,10 @@ class Symmetry {
     return _symmetries;
   }
 
+  size_t memory_bytes() const {
+    return sizeof(*this) + heap_bytes(_symmetries) + heap_bytes(rotations) + heap_bytes(eviscerations);
+  }
+
   void dump_symmetries() const {
     int line = 0;
     for (const auto& board : _symmetries) {
@@ -715,6 +754,14 @@ class SymmeTrie {
     return static_cast<SymLine>(nodes.size());
   }
 
+  size_t memory_bytes() const {
+    size_t bytes = sizeof(*this) + nodes.capacity() * sizeof(Node);
+    for (const auto& node : nodes) {
+      bytes += heap_bytes(node.similar) + heap_bytes(node.next) + heap_bytes(node.mask);
+    }
+    return bytes;
+  }
+
  private:
   struct Node {
     explicit Node(const vector<SymLine>& similar)
@@ -854,6 +901,11 @@ class BoardData {
     trie.dump_similar(line);
   }
 
+  // The tables of the board, shared by the whole search.
+  size_t memory_bytes() const {
+    return geom.memory_bytes() + sym.memory_bytes() + trie.memory_bytes();
+  }
+
   bool has_symmetry(NodeLine line) const {
     return !trie.is_identity(line);
   }
@@ -862,6 +914,10 @@ class BoardData {
     return mark == Mark::X ? geom.zobrist_x()[pos] : geom.zobrist_o()[pos];
   }
 
+  Signature get_signature(Position pos, Mark mark) const {
+    return mark == Mark::X ? geom.signature_x()[pos] : geom.signature_o()[pos];
+  }
+
  private:
   const Geometry<N, D> geom;
   const Symmetry<N, D> sym;
@@ -3,6 +3,8 @@
 
 #include "boarddata.hh"
 #include "strategies.hh"
+#include "arena.hh"
+#include "timers.hh"
 
 class DummyCout {
  public:
@@ -30,6 +32,7 @@ struct DefaultConfig {
   DummyCout debug;
   bool should_prune = true;
   bool should_log_evolution = false;
+  size_t transposition_bytes = 16 << 20;
 };
 
 enum class Reason {
@@ -68,36 +71,98 @@ ostream& operator<<(ostream& oss, const Reason& value) {
     case Reason::UNKNOWN:
       oss << "UNKNOWN"s;
       break;
+    case Reason::TABLEBASE:
+      oss << "TABLEBASE"s;
+      break;
     }
   return oss;
 }
 
 template<int M>
-class Node {
- public:
+class NodeArena;
+
+// Initial proof and disproof numbers of a new node. The default only looks
+// at the number of moves: the side to move needs one good move, while the
+// other side needs all of them.
+struct MobilityInit {
   static ProofNumber initial_proof(Turn turn, int children_size) {
     return turn == Turn::X ? 1_pn : ProofNumber{children_size};
   }
   static ProofNumber initial_disproof(Turn turn, int children_size) {
     return turn == Turn::X ? ProofNumber{children_size} : 1_pn;
   }
+  template<int N, int D>
+  static pair<ProofNumber, ProofNumber> initial(const State<N, D>& state, Turn turn, int children_size) {
+    return {initial_proof(turn, children_size), initial_disproof(turn, children_size)};
+  }
+};
+
+// Counts the lines X can still complete. The more there are, the more
+// moves O needs to disprove the node.
+struct LiveLineInit {
+  template<int N, int D>
+  static pair<ProofNumber, ProofNumber> initial(const State<N, D>& state, Turn turn, int children_size) {
+    int live = 0;
+    for (int count = 0; count < N; count++) {
+      for ([[maybe_unused]] auto line : state.get_line_marks(MarkCount{count}, count == 0 ? Mark::empty : Mark::X)) {
+        live++;
+      }
+    }
+    if (turn == Turn::X) {
+      return {1_pn, ProofNumber{max(live, 1)}};
+    }
+    return {MobilityInit::initial_proof(turn, children_size), ProofNumber{1 + live / N}};
+  }
+};
+
+// The initializer is picked by the config, with MobilityInit by default.
+template<typename Config>
+struct ProofInitOf {
+  using type = MobilityInit;
+};
+
+template<typename Config>
+  requires requires { typename Config::ProofInit; }
+struct ProofInitOf<Config> {
+  using type = typename Config::ProofInit;
+};
+
+template<int M>
+class Node {
+ public:
+  static ProofNumber initial_proof(Turn turn, int children_size) {
+    return MobilityInit::initial_proof(turn, children_size);
+  }
+  static ProofNumber initial_disproof(Turn turn, int children_size) {
+    return MobilityInit::initial_disproof(turn, children_size);
+  }
   Node(Node *parent_node, Turn turn, int children_size)
-      : children_size(children_size), children(children_size, nullptr) {
-    position.reserve(children_size);
-    packed_values.parent = static_cast<signed>(distance(parent_node, this));
-    packed_values.zobrist_first = static_cast<signed>(0);
-    packed_values.zobrist_next = static_cast<signed>(0);
+      : children_size(static_cast<uint8_t>(children_size)) {
+    assert(children_size <= numeric_limits<uint8_t>::max());
+    packed_values.parent = parent_node == nullptr ? 0 : Arena::handle_of(parent_node);
+    packed_values.zobrist_first = 0;
+    packed_values.zobrist_next = 0;
     packed_values.count = static_cast<unsigned>(0);
     packed_values.value = static_cast<uint8_t>(BoardValue::UNKNOWN);
     packed_values.reason = static_cast<uint8_t>(Reason::UNKNOWN);
     packed_values.is_final = static_cast<uint8_t>(false);
     packed_values.is_root = static_cast<uint8_t>(false);
     packed_values.is_eval = static_cast<uint8_t>(false);
+    packed_values.is_queued = static_cast<uint8_t>(false);
+    packed_values.turn = static_cast<uint8_t>(turn == Turn::O);
+    packed_values.ancestor_final = static_cast<uint8_t>(
+        parent_node != nullptr && (parent_node->is_final() || parent_node->some_parent_final()));
+    packed_values.depth = parent_node == nullptr ? 1 : parent_node->packed_values.depth + 1;
+    packed_values.move = 0;
     packed_values.proof = static_cast<unsigned>(initial_proof(turn, children_size));
     packed_values.disproof = static_cast<unsigned>(initial_disproof(turn, children_size));
   }
-  constexpr static unsigned nodes_width = bit_width(static_cast<unsigned>(M));
-  constexpr static unsigned pointer_width = 1 + nodes_width;
+  // Links are arena handles. Zobrist links are stored plus one, so zero
+  // means the node itself for zobrist_first and no node for zobrist_next.
+  // The path from the root is cached: depth, side to move, index of the
+  // move in the parent, and whether some ancestor is final.
+  using Arena = NodeArena<M>;
+  using Handle = typename ChunkedArena<Node>::Handle;
   constexpr static unsigned proof_width = 16;
   constexpr static ProofNumber INFTY = ProofNumber{(1u << proof_width) - 1};
   struct {
@@ -106,25 +171,48 @@ class Node {
     uint8_t is_final : 1;
     uint8_t is_root : 1;
     uint8_t is_eval : 1;
-    unsigned count : nodes_width;
-    signed parent : pointer_width;
-    signed zobrist_first : pointer_width;
-    signed zobrist_next : pointer_width;
+    uint8_t is_queued : 1;
+    uint8_t turn : 1;
+    uint8_t ancestor_final : 1;
+    uint8_t depth;
+    uint8_t move;
+    unsigned count;
+    Handle parent;
+    Handle zobrist_first;
+    Handle zobrist_next;
     unsigned proof : proof_width;
     unsigned disproof : proof_width;
   } packed_values;
-  unsigned children_size;
+  // Offset of the slab run with the children, allocated with the first
+  // position. The run holds children_size handles, where zero means no
+  // child since the root is never a child, followed by the positions.
+  uint32_t slab = 0;
+  uint8_t children_size;
+  uint8_t position_count = 0;
   bool children_built = false;
   float work = 0.0f;
-  vector<uint8_t> position;
-  vector<Node<M>*> children;
+
+  static unsigned slab_words(unsigned children_size) {
+    return children_size + (children_size + 3) / 4;
+  }
 
   bool has_position() const {
-    return !position.empty();
+    return position_count > 0;
   }
 
   void add_position(Position pos) {
-    position.push_back(pos);
+    if (position_count == 0) {
+      slab = arena().slabs.allocate(slab_words(children_size));
+    }
+    positions()[position_count++] = static_cast<uint8_t>(pos);
+  }
+
+  int get_position_count() const {
+    return position_count;
+  }
+
+  Position get_position_at(int index) const {
+    return Position{positions()[index]};
   }
 
   bool has_children() const {
@@ -132,8 +220,8 @@ class Node {
   }
 
   int get_position_index(Position pos) {
-    for (int i = 0; i < static_cast<int>(position.size()); i++) {
-      if (position[i] == pos) {
+    for (int i = 0; i < position_count; i++) {
+      if (positions()[i] == pos) {
         return i;
       }
     }
@@ -142,58 +230,135 @@ class Node {
 
   auto emplace_child(Position pos, Node *child) {
     children_built = true;
-    children[get_position_index(pos)] = child;
-    assert(children.size() <= children_size);
+    set_child(get_position_index(pos), child);
     return make_pair(pos, child);
   }
 
-  const vector<pair<Position, Node*>> get_children() const {
-    assert(children_built);
-    vector<pair<Position, Node*>> copy_children;
-    for (int i = 0; i < static_cast<int>(position.size()); i++) {
-      Position pos = Position{position[i]};
-      Node *child = children[i];
-      if (child->get_reason() == Reason::PRUNING) {
-        continue;
+  // Lazy range over the built children. Unbuilt and PRUNING children are
+  // skipped and ZOBRIST children are redirected to the first node of their
+  // chain, without copying the children anywhere.
+  class ChildrenView {
+   public:
+    class iterator {
+     public:
+      using iterator_category = forward_iterator_tag;
+      using value_type = pair<Position, Node*>;
+      using difference_type = ptrdiff_t;
+      using pointer = const value_type*;
+      using reference = const value_type&;
+
+      iterator() = default;
+      iterator(const Node *node, int index) : node(node), index(index) {
+        skip();
+      }
+      reference operator*() const {
+        return current;
+      }
+      pointer operator->() const {
+        return &current;
+      }
+      iterator& operator++() {
+        index++;
+        skip();
+        return *this;
+      }
+      iterator operator++(int) {
+        iterator old = *this;
+        ++*this;
+        return old;
       }
-      if (child->get_reason() == Reason::ZOBRIST) {
-        copy_children.emplace_back(pos, child->get_zobrist_first());
-      } else {
-        copy_children.emplace_back(pos, child);
+      bool operator==(const iterator& other) const {
+        return index == other.index;
       }
+      bool operator!=(const iterator& other) const {
+        return index != other.index;
+      }
+     private:
+      const Node *node = nullptr;
+      int index = 0;
+      value_type current;
+
+      void skip() {
+        for (; node != nullptr && index < node->position_count; index++) {
+          Node *child = node->get_child(index);
+          // Children are left unbuilt when the node budget runs out.
+          if (child == nullptr || child->get_reason() == Reason::PRUNING) {
+            continue;
+          }
+          if (child->get_reason() == Reason::ZOBRIST) {
+            child = child->get_zobrist_first();
+          }
+          current = make_pair(node->get_position_at(index), child);
+          return;
+        }
+      }
+    };
+
+    ChildrenView() = default;
+    explicit ChildrenView(const Node *node) : node(node), count(node->position_count) {
+    }
+    iterator begin() const {
+      return iterator(node, 0);
+    }
+    iterator end() const {
+      return iterator(nullptr, count);
+    }
+    size_t size() const {
+      return distance(begin(), end());
     }
-    return copy_children;
+    bool empty() const {
+      return begin() == end();
+    }
+   private:
+    const Node *node = nullptr;
+    int count = 0;
+  };
+
+  ChildrenView get_children() const {
+    assert(children_built);
+    return ChildrenView(this);
   }
   Node *get_child(int child) const {
-    return children[child];
+    if (position_count == 0 || child_handles()[child] == 0) {
+      return nullptr;
+    }
+    return &arena()[child_handles()[child]];
+  }
+  void set_child(int child, Node *node) {
+    child_handles()[child] = node == nullptr ? 0 : Arena::handle_of(node);
+    if (node != nullptr) {
+      node->packed_values.move = static_cast<uint8_t>(child);
+    }
+  }
+  Handle *child_handles() const {
+    return arena().slabs.at(slab);
+  }
+  uint8_t *positions() const {
+    return reinterpret_cast<uint8_t *>(child_handles() + children_size);
+  }
+  Arena& arena() const {
+    return static_cast<Arena&>(*ChunkedArena<Node>::arena_of(this));
   }
   Node *get_zobrist_first() {
-    Node *next = this;
-    advance(next, -static_cast<signed>(packed_values.zobrist_first));
-    return next;
+    if (packed_values.zobrist_first == 0) {
+      return this;
+    }
+    return &arena()[packed_values.zobrist_first - 1];
   }
   Node *get_zobrist_next() {
     if (packed_values.zobrist_next == 0) {
       return nullptr;
     }
-    Node *next = this;
-    advance(next, -static_cast<signed>(packed_values.zobrist_next));
-    return next;
+    return &arena()[packed_values.zobrist_next - 1];
   }
   void set_zobrist_first(Node *node) {
-    packed_values.zobrist_first = static_cast<signed>(distance(node, this));
+    packed_values.zobrist_first = node == this ? 0 : Arena::handle_of(node) + 1;
   }
   void set_zobrist_next(Node *node) {
-    if (node == nullptr) {
-      packed_values.zobrist_next = 0;
-    } else {
-      packed_values.zobrist_next = static_cast<signed>(distance(node, this));
-    }
+    packed_values.zobrist_next = node == nullptr ? 0 : Arena::handle_of(node) + 1;
   }
   const Node *get_parent() const {
-    const Node *next = this;
-    advance(next, -static_cast<signed>(packed_values.parent));
-    return next;
+    return &arena()[packed_values.parent];
   }
   ProofNumber get_disproof() const {
     return static_cast<ProofNumber>(packed_values.disproof);
@@ -208,9 +373,7 @@ class Node {
     packed_values.proof = static_cast<unsigned>(proof);
   }
   Node *get_parent() {
-    Node *next = this;
-    advance(next, -static_cast<signed>(packed_values.parent));
-    return next;
+    return &arena()[packed_values.parent];
   }
   NodeCount get_count() const {
     return static_cast<NodeCount>(packed_values.count);
@@ -243,6 +406,12 @@ class Node {
   void set_is_eval(bool is_eval) {
     packed_values.is_eval = is_eval;
   }
+  bool is_queued() const {
+    return packed_values.is_queued;
+  }
+  void set_is_queued(bool is_queued) {
+    packed_values.is_queued = is_queued;
+  }
   bool is_root() const {
     return packed_values.is_root;
   }
@@ -253,37 +422,33 @@ class Node {
     return packed_values.is_final;
   }
   void set_is_final(bool is_final) {
+    if (packed_values.is_final == is_final) {
+      return;
+    }
     packed_values.is_final = is_final;
+    // Below a final ancestor the flags of the descendants already hold.
+    if (!packed_values.ancestor_final) {
+      set_ancestor_final(is_final);
+    }
   }
   bool is_parent_final() const {
     return has_parent() ? get_parent()->is_final() : false;
   }
   bool some_parent_final() const {
-    for (const Node *p = this; p->has_parent();) {
-      p = p->get_parent();
-      if (p->is_final()) {
-        return true;
-      }
-    }
-    return false;
+    return packed_values.ancestor_final;
   }
   Position get_position() const {
-    for (const auto& [pos, child] : get_parent()->get_children()) {
-      if (child == this) {
-        return pos;
-      }
-    }
-    assert(false);
+    assert(get_parent()->get_child(packed_values.move) == this);
+    return get_parent()->get_position_at(packed_values.move);
   }
   Turn get_turn() const {
-    return get_depth() % 2 == 1 ? Turn::X : Turn::O;
+    return packed_values.turn ? Turn::O : Turn::X;
+  }
+  void set_turn(Turn turn) {
+    packed_values.turn = static_cast<uint8_t>(turn == Turn::O);
   }
   int get_depth() const {
-    int depth = 1;
-    for (const Node *p = this; p->has_parent(); p = p->get_parent()) {
-      depth++;
-    }
-    return depth;
+    return packed_values.depth;
   }
   template<int N, int D>
   State<N, D> rebuild_state(const BoardData<N, D>& data) const {
@@ -340,6 +505,21 @@ class Node {
     return estimate_work(0.0);
   }
  private:
+  // Sets the flag on the descendants up to the next final node, whose own
+  // descendants keep the flag either way.
+  void set_ancestor_final(bool ancestor_final) {
+    for (int i = 0; i < position_count; i++) {
+      Node *child = get_child(i);
+      if (child == nullptr || child->packed_values.ancestor_final == ancestor_final) {
+        continue;
+      }
+      child->packed_values.ancestor_final = ancestor_final;
+      if (!child->is_final()) {
+        child->set_ancestor_final(ancestor_final);
+      }
+    }
+  }
+
   double estimate_work(double child_value) const {
     if (!has_parent()) {
       return child_value;
@@ -369,8 +549,113 @@ class Node {
   }
 };
 
+// Nodes waiting to be recomputed from their children, deepest first, so a
+// node comes out after every dirty node below it. The queued bit keeps
+// each node in the heap once.
+template<int M>
+class NodeWorklist {
+ public:
+  void push(Node<M> *node) {
+    if (!node->is_queued()) {
+      node->set_is_queued(true);
+      heap.emplace_back(node->get_depth(), node);
+      push_heap(begin(heap), end(heap));
+    }
+  }
+  Node<M> *pop() {
+    pop_heap(begin(heap), end(heap));
+    auto node = heap.back().second;
+    heap.pop_back();
+    node->set_is_queued(false);
+    return node;
+  }
+  bool empty() const {
+    return heap.empty();
+  }
+  size_t memory_bytes() const {
+    return heap.capacity() * sizeof(heap[0]);
+  }
+  // Queues the parents of every node in the zobrist chain of the node.
+  void push_parents(Node<M> *node) {
+    if (node->has_parent()) {
+      for (auto sibling = node->get_zobrist_first(); sibling != nullptr; sibling = sibling->get_zobrist_next()) {
+        push(sibling->get_parent());
+      }
+    }
+  }
+ private:
+  vector<pair<int, Node<M>*>> heap;
+};
+
+// Runs of 32-bit words carved from fixed chunks. A run never crosses a
+// chunk, so it is addressed by a single word offset.
+class SlabArena {
+ public:
+  constexpr static uint32_t chunk_words = 1 << 16;
+
+  uint32_t allocate(unsigned words) {
+    if (used % chunk_words + words > chunk_words) {
+      used = (used / chunk_words + 1) * chunk_words;
+    }
+    if (used + words > chunks.size() * chunk_words) {
+      chunks.emplace_back(new uint32_t[chunk_words]);
+    }
+    uint32_t offset = used;
+    fill_n(at(offset), words, 0u);
+    used += words;
+    return offset;
+  }
+
+  uint32_t *at(uint32_t offset) const {
+    return chunks[offset / chunk_words].get() + offset % chunk_words;
+  }
+
+  size_t memory_bytes() const {
+    return chunks.size() * chunk_words * sizeof(uint32_t);
+  }
+
+  size_t used_bytes() const {
+    return used * sizeof(uint32_t);
+  }
+
+  // Drops every run but keeps the chunks for the next ones.
+  void clear() {
+    used = 0;
+  }
+
+  void reserve(size_t words) {
+    chunks.reserve(words / chunk_words + 2);
+  }
+
+ private:
+  vector<unique_ptr<uint32_t[]>> chunks;
+  uint32_t used = 0;
+};
+
+template<int M>
+class NodeArena : public ChunkedArena<Node<M>> {
+ public:
+  explicit NodeArena(size_t budget) : ChunkedArena<Node<M>>(budget) {
+  }
+  size_t memory_bytes() const {
+    return ChunkedArena<Node<M>>::memory_bytes() + slabs.memory_bytes();
+  }
+  // The child arrays count toward the node budget, in node sizes.
+  bool is_full() const {
+    return this->size() + slabs.used_bytes() / sizeof(Node<M>) >= this->get_budget();
+  }
+  void reserve() {
+    ChunkedArena<Node<M>>::reserve();
+    slabs.reserve(this->get_budget() * sizeof(Node<M>) / sizeof(uint32_t));
+  }
+  SlabArena slabs;
+};
+
 template<int N, int D, int M>
 struct BoardNode {
+  // Nodes keep positions, child counts and depths, which reach one past
+  // the board size, in single bytes.
+  static_assert(BoardData<N, D>::board_size < 255, "board too large for the node layout");
   State<N, D> current_state;
   Turn turn;
   Node<M> *node;
@@ -384,22 +669,28 @@ struct Embryo {
   Turn turn;
   int children_size;
   State<N, D> state;
-  Node<M>** self;
+  int index;
   ProofNumber proof;
   ProofNumber disproof;
   Embryo(Position pos, LineCount accumulation_point, Node<M>* parent, Turn turn, int children_size,
-         State<N, D> state, Node<M>** self)
+         State<N, D> state, int index)
       : pos(pos), accumulation_point(accumulation_point),
         parent(parent), turn(turn), children_size(children_size),
-        state(state), self(self) {
-    if (*self != nullptr) {
-      proof = (*self)->get_proof();
-      disproof = (*self)->get_disproof();
+        state(state), index(index) {
+    if (auto node = child(); node != nullptr) {
+      proof = node->get_proof();
+      disproof = node->get_disproof();
     } else {
       proof = Node<M>::initial_proof(turn, children_size);
       disproof = Node<M>::initial_disproof(turn, children_size);
     }
   }
+  // A transposed child stands for the first node of its zobrist chain,
+  // which holds its numbers and its children.
+  Node<M> *child() const {
+    auto node = parent->get_child(index);
+    return node != nullptr && node->get_reason() == Reason::ZOBRIST ? node->get_zobrist_first() : node;
+  }
 };
 
 template<int N, int D, typename Config = DefaultConfig>
@@ -407,8 +698,11 @@ class ChildrenBuilder {
  public:
   constexpr static NodeCount M = Config::max_created;
   constexpr static Config config = Config();
+  using ProofInit = typename ProofInitOf<Config>::type;
+  constexpr static bool timed = TimersOf<Config>::enabled;
 
   bag<Embryo<N, D, M>> get_embryos(const BoardNode<N, D, M>& board_node) {
+    ScopedTimer<timed> timer(Phase::EMBRYOS);
     auto& [current_state, turn, node] = board_node;
     auto open_positions = current_state.get_open_positions(to_mark(turn));
     vector<Position> sorted_positions;
@@ -418,21 +712,19 @@ class ChildrenBuilder {
     sort(begin(sorted_positions), end(sorted_positions));
     bag<tuple<Position, LineCount, State<N, D>>> embryo_info =
         get_embryo_info(current_state, turn, open_positions, sorted_positions);
+    if (!node->has_position()) {
+      for (const auto& info : embryo_info) {
+        node->add_position(get<0>(info));
+      }
+    }
     bag<Embryo<N, D, M>> embryos;
-
     for (int i = 0; i < static_cast<int>(embryo_info.size()); i++) {
       auto& [position, current_accumulation, child_state] = embryo_info[i];
       auto children_size = child_state.get_open_positions(to_mark(flip(turn))).count();
       auto& embryo = embryos.emplace_back(
-          position, current_accumulation, node, flip(turn), children_size, child_state, &node->children[i]);
-      if (node->children[i] != nullptr) {
-        embryo.proof = node->children[i]->get_proof();
-        embryo.disproof = node->children[i]->get_disproof();
-      }
-    }
-    if (!node->has_position()) {
-      for (auto& embryo : embryos) {
-        node->add_position(embryo.pos);
+          position, current_accumulation, node, flip(turn), children_size, child_state, i);
+      if (embryo.child() == nullptr) {
+        tie(embryo.proof, embryo.disproof) = ProofInit::initial(child_state, flip(turn), children_size);
       }
     }
     return embryos;
@@ -440,9 +732,13 @@ class ChildrenBuilder {
 
   template<typename S>
   auto build_children(S& solution, int& nodes_created, bag<Embryo<N, D, M>>& embryos) {
+    ScopedTimer<timed> timer(Phase::CREATE);
     bag<BoardNode<N, D, M>> children;
     for (int i = 0; i < static_cast<int>(embryos.size()); i++) {
-      if (nodes_created == config.max_created) {
+      // The first child is always built: the positions allocated by
+      // get_embryos may have just filled the budget, and df-pn descends
+      // into some child of every node it expands.
+      if (i > 0 && solution.is_full()) {
         return children;
       }
       nodes_created++;
@@ -457,7 +753,8 @@ class ChildrenBuilder {
     const auto& child = embryo.state;
     const pair<Position, Node<M>*>& child_node = embryo.parent->emplace_child(embryo.pos,
         solution.create_node(embryo.parent, embryo.turn, embryo.children_size));
-    *embryo.self = child_node.second;
+    child_node.second->set_proof(embryo.proof);
+    child_node.second->set_disproof(embryo.disproof);
     return BoardNode<N, D, M>{child, embryo.turn, child_node.second};
   }
 
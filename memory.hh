@@ -0,0 +1,99 @@
+#ifndef MEMORY_HH
+#define MEMORY_HH
+
+#include <array>
+#include <string>
+#include <ostream>
+#include <iomanip>
+#include <sstream>
+#include "boarddata.hh"
+
+enum class MemoryPart {
+  NODES,
+  CHILDREN,
+  TRANSPOSITION,
+  FRONTIER,
+  BOARD_DATA,
+  CHAINING
+};
+
+constexpr int memory_part_count = static_cast<int>(MemoryPart::CHAINING) + 1;
+
+inline const char *memory_part_name(MemoryPart part) {
+  constexpr array<const char *, memory_part_count> names{
+    "nodes", "children", "transposition", "frontier", "board_data", "chaining"
+  };
+  return names[static_cast<int>(part)];
+}
+
+// Live bytes and high-water mark of each subsystem of the solver. The
+// owners are asked for their sizes when the account is updated, so the
+// high-water marks are only as fine as the updates.
+class MemoryAccount {
+ public:
+  struct Usage {
+    size_t live, peak;
+  };
+
+  void update(MemoryPart part, size_t live) {
+    auto& usage = parts[static_cast<int>(part)];
+    usage.live = live;
+    usage.peak = max(usage.peak, live);
+  }
+
+  // For parts whose high-water mark is kept by the owner.
+  void update_peak(MemoryPart part, size_t peak) {
+    auto& usage = parts[static_cast<int>(part)];
+    usage.peak = max(usage.peak, peak);
+  }
+
+  const Usage& get(MemoryPart part) const {
+    return parts[static_cast<int>(part)];
+  }
+
+  size_t total_live() const {
+    size_t total = 0;
+    for (const auto& usage : parts) {
+      total += usage.live;
+    }
+    return total;
+  }
+
+  size_t total_peak() const {
+    size_t total = 0;
+    for (const auto& usage : parts) {
+      total += usage.peak;
+    }
+    return total;
+  }
+
+  void report(ostream& os) const {
+    os << "memory\t\tlive(KB)\tpeak(KB)\n";
+    for (int i = 0; i < memory_part_count; i++) {
+      string name = memory_part_name(static_cast<MemoryPart>(i));
+      os << name << (name.size() < 8 ? "\t\t" : "\t") << kilobytes(parts[i].live) << "\t\t"
+         << kilobytes(parts[i].peak) << "\n";
+    }
+    os << "total\t\t" << kilobytes(total_live()) << "\t\t" << kilobytes(total_peak()) << "\n";
+  }
+
+  // One line for the progress reports.
+  string summary() const {
+    ostringstream oss;
+    oss << "memory " << fixed << setprecision(1) << total_live() / 1048576.0 << "MB";
+    for (int i = 0; i < memory_part_count; i++) {
+      oss << " " << memory_part_name(static_cast<MemoryPart>(i)) << " "
+          << setprecision(1) << parts[i].live / 1048576.0;
+    }
+    return oss.str();
+  }
+
+ private:
+  static size_t kilobytes(size_t bytes) {
+    return (bytes + 1023) / 1024;
+  }
+
+  array<Usage, memory_part_count> parts{};
+};
+
+#endif
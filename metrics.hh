@@ -0,0 +1,168 @@
+#ifndef METRICS_HH
+#define METRICS_HH
+
+#include <atomic>
+#include <array>
+#include <vector>
+#include <chrono>
+#include <ostream>
+#include <iomanip>
+#include "boardnode.hh"
+#include "transposition.hh"
+
+enum class MetricsFormat {
+  JSON,
+  PROMETHEUS
+};
+
+// The default metrics of MiniMax. Every call is empty, so the counting
+// compiles away.
+struct NoMetrics {
+  constexpr static bool enabled = false;
+  void start() {
+  }
+  void count_visit(int depth) {
+  }
+  void count_expansion(int depth) {
+  }
+  void count_reason(Reason reason) {
+  }
+  void count_chaining(int visited) {
+  }
+};
+
+// Counters of a search, picked with `using Metrics = SearchMetrics;` in the
+// config. Only the chaining counters are touched by the parallel evaluation,
+// so only they are atomic.
+struct SearchMetrics {
+  constexpr static bool enabled = true;
+  constexpr static int reason_count = static_cast<int>(Reason::TABLEBASE) + 1;
+
+  chrono::steady_clock::time_point started = chrono::steady_clock::now();
+  array<uint64_t, reason_count> reasons{};
+  vector<uint64_t> expansions;
+  int max_depth = 0;
+  atomic<uint64_t> chaining_searches = 0, chaining_visits = 0;
+
+  void start() {
+    started = chrono::steady_clock::now();
+  }
+  void count_visit(int depth) {
+    max_depth = max(max_depth, depth);
+  }
+  void count_expansion(int depth) {
+    if (depth >= static_cast<int>(expansions.size())) {
+      expansions.resize(depth + 1);
+    }
+    expansions[depth]++;
+  }
+  void count_reason(Reason reason) {
+    reasons[static_cast<int>(reason)]++;
+  }
+  void count_chaining(int visited) {
+    chaining_searches.fetch_add(1, memory_order_relaxed);
+    chaining_visits.fetch_add(visited, memory_order_relaxed);
+  }
+};
+
+// The metrics at one point of the search, together with the totals kept
+// elsewhere. Branching factors are measured on the nodes in the tree.
+struct MetricsSnapshot {
+  uint64_t nodes_visited, nodes_created;
+  double seconds;
+  array<uint64_t, SearchMetrics::reason_count> reasons;
+  TranspositionTable::Stats transposition;
+  vector<uint64_t> expansions;
+  vector<double> branching;
+  int max_depth;
+  uint64_t chaining_searches, chaining_visits;
+
+  double nodes_per_second() const {
+    return seconds > 0.0 ? nodes_visited / seconds : 0.0;
+  }
+
+  double hit_rate() const {
+    auto probes = transposition.hits + transposition.misses;
+    return probes > 0 ? static_cast<double>(transposition.hits) / probes : 0.0;
+  }
+
+  void write(ostream& os, MetricsFormat format) const {
+    if (format == MetricsFormat::JSON) {
+      write_json(os);
+    } else {
+      write_prometheus(os);
+    }
+  }
+
+  void write_json(ostream& os) const {
+    os << "{\n";
+    os << "  \"nodes_visited\": " << nodes_visited << ",\n";
+    os << "  \"nodes_created\": " << nodes_created << ",\n";
+    os << "  \"seconds\": " << seconds << ",\n";
+    os << "  \"nodes_per_second\": " << nodes_per_second() << ",\n";
+    os << "  \"reasons\": {";
+    for (int i = 0; i < SearchMetrics::reason_count; i++) {
+      os << (i > 0 ? ", " : "") << "\"" << static_cast<Reason>(i) << "\": " << reasons[i];
+    }
+    os << "},\n";
+    os << "  \"transposition\": {\"hits\": " << transposition.hits << ", \"misses\": "
+       << transposition.misses << ", \"collisions\": " << transposition.collisions
+       << ", \"stores\": " << transposition.stores << ", \"replacements\": "
+       << transposition.replacements << ", \"hit_rate\": " << hit_rate() << "},\n";
+    os << "  \"expansions_per_depth\": ";
+    write_json_list(os, expansions);
+    os << ",\n  \"branching_per_depth\": ";
+    write_json_list(os, branching);
+    os << ",\n  \"max_depth\": " << max_depth << ",\n";
+    os << "  \"chaining\": {\"searches\": " << chaining_searches << ", \"visits\": "
+       << chaining_visits << "}\n";
+    os << "}\n";
+  }
+
+  void write_prometheus(ostream& os) const {
+    os << "tictactoe_nodes_visited " << nodes_visited << "\n";
+    os << "tictactoe_nodes_created " << nodes_created << "\n";
+    os << "tictactoe_seconds " << seconds << "\n";
+    os << "tictactoe_nodes_per_second " << nodes_per_second() << "\n";
+    for (int i = 0; i < SearchMetrics::reason_count; i++) {
+      os << "tictactoe_reason{reason=\"" << static_cast<Reason>(i) << "\"} " << reasons[i] << "\n";
+    }
+    os << "tictactoe_transposition_hits " << transposition.hits << "\n";
+    os << "tictactoe_transposition_misses " << transposition.misses << "\n";
+    os << "tictactoe_transposition_collisions " << transposition.collisions << "\n";
+    os << "tictactoe_transposition_hit_rate " << hit_rate() << "\n";
+    for (int depth = 0; depth < static_cast<int>(expansions.size()); depth++) {
+      os << "tictactoe_expansions{depth=\"" << depth << "\"} " << expansions[depth] << "\n";
+    }
+    for (int depth = 0; depth < static_cast<int>(branching.size()); depth++) {
+      os << "tictactoe_branching{depth=\"" << depth << "\"} " << branching[depth] << "\n";
+    }
+    os << "tictactoe_max_depth " << max_depth << "\n";
+    os << "tictactoe_chaining_searches " << chaining_searches << "\n";
+    os << "tictactoe_chaining_visits " << chaining_visits << "\n";
+  }
+
+ private:
+  template<typename T>
+  static void write_json_list(ostream& os, const vector<T>& values) {
+    os << "[";
+    for (size_t i = 0; i < values.size(); i++) {
+      os << (i > 0 ? ", " : "") << values[i];
+    }
+    os << "]";
+  }
+};
+
+// The metrics are picked by the config, with NoMetrics by default.
+template<typename Config>
+struct MetricsOf {
+  using type = NoMetrics;
+};
+
+template<typename Config>
+  requires requires { typename Config::Metrics; }
+struct MetricsOf<Config> {
+  using type = typename Config::Metrics;
+};
+
+#endif
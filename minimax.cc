@@ -9,6 +9,7 @@
 #include <bitset>
 #include <execution>
 #include <list>
+#include <sys/resource.h>
 #include "minimax.hh"
 
 struct DebugConfig {
@@ -17,26 +18,114 @@ struct DebugConfig {
   ostream& debug = cout;
   bool should_prune = true;
   bool should_log_evolution = true;
+  size_t transposition_bytes = 256 << 20;
+  constexpr static bool should_time_phases = true;
 };
 
-int main(int argc, char **argv) {
-  constexpr int N = 3;
-  constexpr int D = 2;
+// The quiet config of --json. The node budgets are the same, and the
+// table is smaller so that the peak RSS follows the tree.
+struct BenchConfig {
+  constexpr static NodeCount max_visited = DebugConfig::max_visited;
+  constexpr static NodeCount max_created = DebugConfig::max_created;
+  DummyCout debug;
+  bool should_prune = true;
+  bool should_log_evolution = false;
+  size_t transposition_bytes = 16 << 20;
+};
+
+struct Options {
+  string board = "32";
+  string traversal = "dfs";
+  bool json = false;
+  string dump_file;
+};
+
+long peak_rss_kb() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+template<int N, int D, template<int, int, int> typename Traversal, typename Config>
+int solve(const Options& options) {
   BoardData<N, D> data;
   State state(data);
-  cout << "sizeof(Node) = " << sizeof(Node<MiniMax<N, D>::M>) << "\n";
-  auto minimax = MiniMax<N, D, DFS<N, D, DebugConfig::max_created>, DebugConfig>(state, data);
-  //auto minimax = MiniMax<N, D, PNSearch<N, D, DebugConfig::max_created>, DebugConfig>(state, data);
-  auto result = minimax.play(state, Turn::X);
-  cout << *result << "\n";
-  if (!minimax.get_solution().validate()) {
-    cout << "-- VALIDATION FAILED --\n"s;
+  auto minimax = make_unique<MiniMax<N, D, Traversal<N, D, Config::max_created>, Config>>(state, data);
+  if (!options.json) {
+    cout << "sizeof(Node) = " << sizeof(Node<Config::max_created>) << "\n";
   }
-  if (argc >= 2) {
-    auto& solution = minimax.get_solution();
+  auto start = chrono::steady_clock::now();
+  auto result = minimax->play(state, Turn::X);
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  bool valid = minimax->get_solution().validate();
+  if (options.json) {
+    cout << "{\"board\": \"" << options.board << "\", \"traversal\": \"" << options.traversal
+         << "\", \"seconds\": " << elapsed.count() << ", \"nodes_visited\": " << minimax->nodes_visited
+         << ", \"nodes_created\": " << minimax->nodes_created << ", \"peak_rss_kb\": " << peak_rss_kb()
+         << ", \"value\": \"" << *result << "\", \"valid\": " << (valid ? "true" : "false") << "}\n";
+  } else {
+    cout << *result << "\n";
+    if (!valid) {
+      cout << "-- VALIDATION FAILED --\n"s;
+    }
+  }
+  if (!options.dump_file.empty()) {
+    auto& solution = minimax->get_solution();
     solution.update_count();
-    solution.dump(data, argv[1]);
+    solution.dump(data, options.dump_file);
     solution.dump_dot(data, "pnsearch.dot");
   }
   return 0;
 }
+
+template<int N, int D, typename Config>
+int solve_board(const Options& options) {
+  if (options.traversal == "dfs") {
+    return solve<N, D, DFS, Config>(options);
+  } else if (options.traversal == "bfs") {
+    return solve<N, D, BFS, Config>(options);
+  } else if (options.traversal == "pn") {
+    return solve<N, D, PNSearch, Config>(options);
+  }
+  cerr << "unsupported traversal " << options.traversal << "\n";
+  return 1;
+}
+
+template<typename Config>
+int solve_config(const Options& options) {
+  if (options.board == "32") {
+    return solve_board<3, 2, Config>(options);
+  } else if (options.board == "33") {
+    return solve_board<3, 3, Config>(options);
+  } else if (options.board == "42") {
+    return solve_board<4, 2, Config>(options);
+  } else if (options.board == "43") {
+    return solve_board<4, 3, Config>(options);
+  }
+  cerr << "unsupported board " << options.board << "\n";
+  return 1;
+}
+
+// Usage: minimax [--board 32|33|42|43] [--traversal dfs|bfs|pn] [--json]
+//                [solution file]
+// Without options it solves 3^2 with DFS, as it always did.
+int main(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "--board" && i + 1 < argc) {
+      options.board = argv[++i];
+    } else if (arg == "--traversal" && i + 1 < argc) {
+      options.traversal = argv[++i];
+    } else if (arg == "--json") {
+      options.json = true;
+    } else if (arg.starts_with("-") || !options.dump_file.empty()) {
+      cerr << "unknown argument " << arg << "\n";
+      cerr << "usage: minimax [--board 32|33|42|43] [--traversal dfs|bfs|pn] [--json] [solution file]\n";
+      return 1;
+    } else {
+      options.dump_file = arg;
+    }
+  }
+  return options.json ? solve_config<BenchConfig>(options) : solve_config<DebugConfig>(options);
+}
@@ -18,12 +18,24 @@
 #include <stack>
 #include <mutex>
 #include <numeric>
+#include <csignal>
+#include <filesystem>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
 #include "semantic.hh"
 #include "boarddata.hh"
 #include "state.hh"
 #include "solutiontree.hh"
 #include "strategies.hh"
 #include "traversal.hh"
+#include "tablebase.hh"
+#include "transposition.hh"
+#include "metrics.hh"
+#include "timers.hh"
+#include "trace.hh"
+#include "memory.hh"
 
 enum class Outcome {
   X_WINS,
@@ -56,6 +68,19 @@ constexpr Outcome known_outcome<4, 3>() {
   return Outcome::X_WINS;
 }
 
+// The chaining strategy is tried on every leaf unless the config turns it
+// off with `constexpr static bool should_chain = false;`.
+template<typename Config>
+struct ChainingOf {
+  constexpr static bool enabled = true;
+};
+
+template<typename Config>
+  requires requires { Config::should_chain; }
+struct ChainingOf<Config> {
+  constexpr static bool enabled = Config::should_chain;
+};
+
 template<int N, int D,
     typename Traversal = DFS<N, D, DefaultConfig::max_created>,
     typename Config = DefaultConfig,
@@ -65,34 +90,343 @@ class MiniMax {
   constexpr static Position board_size = BoardData<N, D>::board_size;
   constexpr static NodeCount M = Config::max_created;
   constexpr static Config config = Config();
+  using Metrics = typename MetricsOf<Config>::type;
+  constexpr static bool timed = TimersOf<Config>::enabled;
 
   MiniMax(
       const State<N, D>& state,
       const BoardData<N, D>& data)
-      :  state(state), data(data), solution(board_size), traversal(data, solution.get_root()) {
+      :  state(state), data(data), solution(board_size), traversal(data, solution.get_root()),
+         transposition(config.transposition_bytes) {
     if constexpr (config.should_log_evolution) {
-      ofevolution.open("pnevolution.txt");
+      evolution.open("pnevolution.bin");
     }
+    memory.update(MemoryPart::BOARD_DATA, data.memory_bytes());
   }
   const State<N, D>& state;
   const BoardData<N, D>& data;
   SolutionTree<M> solution;
   Traversal traversal;
-  unordered_map<Zobrist, Node<M>*> zobrist;
+  TranspositionTable transposition;
   int nodes_visited = 0;
   int nodes_created = 1;
   int running_zobrist = 0;
   int running_final = 0;
-  ofstream ofevolution;
+  NodeWorklist<M> dirty;
+  EvolutionTrace evolution;
+  const Tablebase<N, D> *tablebase = nullptr;
+  atomic<int> chaining_record = 0;
+  atomic<int> chaining_clones = 0;
+  MemoryAccount memory;
+  [[no_unique_address]] Metrics metrics;
+  string metrics_file;
+  MetricsFormat metrics_format = MetricsFormat::JSON;
+
+  bool deduplicate = false;
+  int collect_threshold = 0;
+  int next_collection = 0;
+  string checkpoint_file;
+  int checkpoint_interval = 0;
+  int next_checkpoint = 0;
+  pid_t checkpoint_writer = 0;
+  mutex tree_mutex;
+  inline static volatile sig_atomic_t interrupted = 0;
+
+  static void interrupt(int) {
+    interrupted = 1;
+  }
+
+  struct CheckpointHeader {
+    uint32_t magic;
+    uint32_t n, d, m;
+    int nodes_visited, nodes_created, running_zobrist, running_final, chaining_record;
+  };
+  constexpr static uint32_t checkpoint_magic = 0x4b435454;
+  constexpr static bool is_pn_traversal = derived_from<Traversal, PNSearch<N, D, M>>;
+
+  // The metrics are written to the file when play returns.
+  void set_metrics_file(string filename, MetricsFormat format = MetricsFormat::JSON)
+      requires Metrics::enabled {
+    metrics_file = filename;
+    metrics_format = format;
+  }
+
+  MetricsSnapshot get_metrics() requires Metrics::enabled {
+    MetricsSnapshot snapshot{};
+    snapshot.nodes_visited = nodes_visited;
+    snapshot.nodes_created = nodes_created;
+    snapshot.seconds = chrono::duration<double>(chrono::steady_clock::now() - metrics.started).count();
+    snapshot.reasons = metrics.reasons;
+    snapshot.transposition = transposition.stats();
+    snapshot.expansions = metrics.expansions;
+    snapshot.max_depth = metrics.max_depth;
+    snapshot.chaining_searches = metrics.chaining_searches.load();
+    snapshot.chaining_visits = metrics.chaining_visits.load();
+    vector<uint64_t> expanded, children;
+    for (uint32_t i = 0; i < solution.size(); i++) {
+      auto node = solution.at(i);
+      if (int count = node->get_position_count(); count > 0) {
+        if (node->get_depth() >= static_cast<int>(expanded.size())) {
+          expanded.resize(node->get_depth() + 1);
+          children.resize(node->get_depth() + 1);
+        }
+        expanded[node->get_depth()]++;
+        children[node->get_depth()] += count;
+      }
+    }
+    for (size_t depth = 0; depth < expanded.size(); depth++) {
+      snapshot.branching.push_back(expanded[depth] > 0 ?
+          static_cast<double>(children[depth]) / expanded[depth] : 0.0);
+    }
+    return snapshot;
+  }
+
+  void write_metrics(ostream& os, MetricsFormat format) requires Metrics::enabled {
+    get_metrics().write(os, format);
+  }
+
+  // Asks every subsystem for its size. The high-water marks are taken at
+  // each call, which the progress reports make every thousand nodes.
+  const MemoryAccount& get_memory() {
+    memory.update(MemoryPart::NODES, solution.node_bytes());
+    memory.update(MemoryPart::CHILDREN, solution.children_bytes());
+    memory.update(MemoryPart::TRANSPOSITION, transposition.memory_bytes());
+    memory.update(MemoryPart::FRONTIER, traversal.frontier_bytes() + dirty.memory_bytes());
+    // The clones only live during a chaining search.
+    memory.update(MemoryPart::CHAINING, 0);
+    memory.update_peak(MemoryPart::CHAINING, chaining_clones.load() * sizeof(State<N, D>));
+    return memory;
+  }
+
+  // Keeps one evolution record in every `every` visited nodes.
+  void set_evolution_sampling(int every) {
+    evolution.set_sampling(every);
+  }
+
+  void set_tablebase(const Tablebase<N, D>& table) {
+    tablebase = &table;
+  }
+
+  // Config::max_created is only the initial budget of the tree.
+  void set_node_budget(size_t budget) {
+    solution.set_budget(budget);
+  }
+
+  // Saves the search every interval visited nodes. On SIGINT the search
+  // stops and saves once more. The handler is only installed while play
+  // runs, and the previous one is restored when it returns.
+  void set_checkpoint(string filename, int interval) {
+    checkpoint_file = filename;
+    checkpoint_interval = interval;
+    next_checkpoint = nodes_visited + interval;
+  }
+
+  // Shares the transpositions of nodes that are still being searched: a
+  // transposition joins the zobrist chain of the node already expanded and
+  // the search goes on below that node, so the tree becomes a DAG. The sums
+  // of proof numbers then count the children fed by the same shared node
+  // once. A shared node may sit below a final ancestor, so the collector,
+  // which drops those subtrees, cannot run alongside.
+  void set_deduplicate(bool value) requires is_pn_traversal && (!BatchTraversal<Traversal>) {
+    assert(collect_threshold == 0);
+    deduplicate = value;
+    traversal.set_deduplicate(value);
+  }
+
+  // Collects the solved subtrees whenever the tree reaches threshold nodes.
+  // If most of the tree is still live, the next collection waits until the
+  // tree doubles. nodes_created keeps counting every node ever built, the
+  // live ones are solution.size().
+  void set_garbage_collection(int threshold) requires is_pn_traversal {
+    assert(!deduplicate);
+    collect_threshold = threshold;
+    next_collection = threshold;
+  }
+
+  void check_garbage_collection() {
+    if constexpr (is_pn_traversal) {
+      if (collect_threshold > 0 && static_cast<int>(solution.size()) >= next_collection) {
+        collect_garbage();
+        next_collection = max(collect_threshold, 2 * static_cast<int>(solution.size()));
+      }
+    }
+  }
+
+  void collect_garbage() {
+    auto forward = solution.collect();
+    transposition.relocate([&](uint32_t index) -> optional<uint32_t> {
+      if (forward[index] == SolutionTree<M>::no_node) {
+        return {};
+      }
+      return forward[index];
+    });
+    traversal.relocate();
+  }
+
+  // Clears the tree, the table and the counters for a new search, keeping
+  // their memory. The traversal must not hold nodes other than the root.
+  void reset() requires is_pn_traversal {
+    solution.reset(board_size);
+    transposition.clear();
+    traversal.reset();
+    nodes_visited = 0;
+    nodes_created = 1;
+    running_zobrist = 0;
+    running_final = 0;
+  }
+
+  // Only the proof-number traversals keep their whole frontier in the tree,
+  // so only they can pick up a search from a checkpoint. The whole file is
+  // checked before the tree and the table are touched, so a stale or
+  // truncated checkpoint leaves the current search as it was.
+  bool resume(string filename) requires is_pn_traversal {
+    ifstream ifs(filename, ios::binary);
+    CheckpointHeader header;
+    ifs.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!ifs || header.magic != checkpoint_magic || header.n != N || header.d != D || header.m != M) {
+      return false;
+    }
+    auto body = ifs.tellg();
+    if (!solution.check(ifs) || !transposition.check(ifs)) {
+      return false;
+    }
+    ifs.seekg(body);
+    if (!solution.load(ifs) || !transposition.load(ifs)) {
+      return false;
+    }
+    nodes_visited = header.nodes_visited;
+    nodes_created = header.nodes_created;
+    running_zobrist = header.running_zobrist;
+    running_final = header.running_final;
+    chaining_record = header.chaining_record;
+    next_checkpoint = nodes_visited + checkpoint_interval;
+    return true;
+  }
+
+  // The file is written to a temporary name and renamed only when it is
+  // complete and on disk, so a crash or a failed write always leaves the
+  // previous checkpoint intact.
+  bool write_checkpoint(string filename) {
+    string temporary = filename + ".tmp"s;
+    bool written = false;
+    {
+      ofstream ofs(temporary, ios::binary);
+      CheckpointHeader header{checkpoint_magic, N, D, M, nodes_visited, nodes_created,
+          running_zobrist, running_final, chaining_record.load()};
+      ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+      solution.save(ofs);
+      transposition.save(ofs);
+      ofs.flush();
+      written = ofs.good();
+    }
+    if (written) {
+      int fd = open(temporary.c_str(), O_RDONLY);
+      written = fd >= 0 && fsync(fd) == 0;
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+    if (!written || rename(temporary.c_str(), filename.c_str()) != 0) {
+      unlink(temporary.c_str());
+      config.debug << "Could not write checkpoint "s << filename << "\n"s;
+      return false;
+    }
+    return true;
+  }
+
+  // Threads do not survive a fork, so a child forked while a TBB worker or
+  // the trace writer holds the allocator lock would deadlock on it.
+  static bool is_single_threaded() {
+    error_code error;
+    auto tasks = filesystem::directory_iterator("/proc/self/task", error);
+    return !error && distance(begin(tasks), end(tasks)) == 1;
+  }
+
+  // A forked child writes the copy-on-write snapshot of the search, so the
+  // search only pauses for the fork. A checkpoint is skipped if the last one
+  // is still being written. When the process has other threads, the
+  // checkpoint is written in place instead.
+  void checkpoint() {
+    if (checkpoint_writer > 0) {
+      int status = 0;
+      if (waitpid(checkpoint_writer, &status, WNOHANG) == 0) {
+        return;
+      }
+      checkpoint_writer = 0;
+      report_writer(status);
+    }
+    pid_t pid = is_single_threaded() ? fork() : -1;
+    if (pid == 0) {
+      _exit(write_checkpoint(checkpoint_file) ? 0 : 1);
+    }
+    if (pid < 0) {
+      write_checkpoint(checkpoint_file);
+    } else {
+      checkpoint_writer = pid;
+    }
+  }
+
+  void report_writer(int status) {
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      config.debug << "Checkpoint writer failed\n"s;
+    }
+  }
+
+  void check_checkpoint() {
+    if (!checkpoint_file.empty() && nodes_visited >= next_checkpoint) {
+      next_checkpoint = nodes_visited + checkpoint_interval;
+      checkpoint();
+    }
+  }
+
+  void finish_checkpoint() {
+    if (checkpoint_writer > 0) {
+      int status = 0;
+      waitpid(checkpoint_writer, &status, 0);
+      checkpoint_writer = 0;
+      report_writer(status);
+    }
+    if (interrupted && !checkpoint_file.empty()) {
+      write_checkpoint(checkpoint_file);
+    }
+  }
 
   optional<BoardValue> play(State<N, D>& current_state, Turn turn) {
+    interrupted = 0;
+    bool handles_interrupt = !checkpoint_file.empty();
+    auto previous_handler = handles_interrupt ? signal(SIGINT, interrupt) : SIG_DFL;
+    solution.get_root()->set_turn(turn);
+    metrics.start();
+    if constexpr (timed) {
+      PhaseTimers::reset();
+    }
     auto ans = queue_play(BoardNode<N, D, M>{current_state, turn, solution.get_root()});
+    if constexpr (timed) {
+      ostringstream breakdown;
+      PhaseTimers::report(breakdown);
+      config.debug << breakdown.str();
+    }
+    ostringstream memory_report;
+    get_memory().report(memory_report);
+    config.debug << memory_report.str();
+    if constexpr (Metrics::enabled) {
+      if (!metrics_file.empty()) {
+        ofstream ofs(metrics_file);
+        write_metrics(ofs, metrics_format);
+      }
+    }
     config.debug << "Total nodes visited: "s << nodes_visited << "\n"s;
     config.debug << "Nodes in solution tree: "s << solution.real_count() << "\n"s;
+    auto stats = transposition.stats();
+    config.debug << "Transposition hits: "s << stats.hits << " misses: "s << stats.misses
+                 << " collisions: "s << stats.collisions << "\n"s;
     if constexpr (config.should_prune) {
       solution.prune();
     }
     config.debug << "Nodes in solution tree after pruning: "s << solution.real_count() << "\n"s;
+    if (handles_interrupt) {
+      signal(SIGINT, previous_handler);
+    }
     return ans;
   }
 
@@ -106,103 +440,383 @@ class MiniMax {
 
   optional<BoardValue> queue_play(BoardNode<N, D, M> root) {
     traversal.push_node(root);
-    while (!traversal.empty() && nodes_visited < config.max_visited && nodes_created < config.max_created) {
-      auto board_node = traversal.pop_best(solution, nodes_created, config);
-      bool is_terminal = process_node(board_node);
-      log_stats(board_node);
-      traversal.retire(board_node, is_terminal);
+    if constexpr (BatchTraversal<Traversal>) {
+      queue_play_batch();
+    } else if constexpr (TaskTraversal<Traversal>) {
+      queue_play_tasks(root);
+    } else {
+      while (!traversal.empty() && nodes_visited < config.max_visited && !solution.is_full()
+             && !interrupted) {
+        auto board_node = select();
+        bool is_terminal = process_node(board_node);
+        log_stats(board_node);
+        retire(board_node, is_terminal);
+        check_checkpoint();
+        check_garbage_collection();
+      }
     }
+    finish_checkpoint();
     return root.node->get_value();
   }
 
+  // The leaves of a batch are evaluated concurrently, and then committed
+  // to the tree one at a time in the order they were selected.
+  void queue_play_batch() {
+    while (!traversal.empty() && nodes_visited < config.max_visited && !solution.is_full()
+           && !interrupted) {
+      auto batch = select_batch();
+      if (batch.empty()) {
+        break;
+      }
+      vector<optional<pair<BoardValue, Reason>>> evaluations(batch.size());
+      traversal.run_parallel(batch.size(), [&](int i) {
+        evaluations[i] = evaluate_node(batch[i].current_state, batch[i].turn);
+      });
+      for (int i = 0; i < static_cast<int>(batch.size()); i++) {
+        traversal.restore(batch[i]);
+        // An earlier leaf of this batch may have solved an ancestor.
+        if (batch[i].node->some_parent_final()) {
+          traversal.discard(batch[i]);
+          continue;
+        }
+        bool is_terminal = process_node(batch[i], [&]() {
+          return evaluations[i];
+        });
+        log_stats(batch[i]);
+        retire(batch[i], is_terminal);
+      }
+      check_checkpoint();
+      check_garbage_collection();
+    }
+  }
+
+  // Links into a transposition chain write the head, which other tasks
+  // may be reading, so they are collected and made once the tasks are done.
+  struct TaskCounters {
+    atomic<int> visited;
+    atomic<int> final;
+    vector<pair<Node<M>*, Node<M>*>> links;
+  };
+
+  // The tree grows from several threads, so its chunk tables are sized for
+  // the whole budget before the search starts.
+  void queue_play_tasks(BoardNode<N, D, M> root) {
+    solution.reserve();
+    TaskCounters counters{nodes_visited, 0, {}};
+    traversal.run_tasks([&]() {
+      search_task(root, counters);
+    });
+    for (auto [node, first] : counters.links) {
+      link_transposition(node, first);
+    }
+    nodes_visited = counters.visited;
+    running_final += counters.final;
+  }
+
+  // Searches the subtree of a node as a task. A task only writes its own
+  // node, and the node's children before their tasks start, so the only
+  // lock is the one around the growth of the tree and the links. Children
+  // that are left unsolved when a sibling settles the node are pruned.
+  void search_task(const BoardNode<N, D, M>& board_node, TaskCounters& counters) {
+    auto& [current_state, turn, node] = board_node;
+    if (tbb::is_current_task_group_canceling() || interrupted ||
+        counters.visited.fetch_add(1, memory_order_relaxed) >= config.max_visited) {
+      return;
+    }
+    TranspositionKey key{current_state.get_zobrist(), current_state.get_signature()};
+    if (auto terminal = evaluate_task(current_state, turn, key); terminal.has_value()) {
+      settle_task(node, terminal->first, terminal->second, true, counters);
+      if (terminal->second == Reason::ZOBRIST) {
+        if (auto first = find_transposition(key); first != nullptr) {
+          lock_guard lock(tree_mutex);
+          counters.links.emplace_back(node, first);
+        }
+      } else {
+        // The table is lockless, the fence publishes the value with the entry.
+        atomic_thread_fence(memory_order_release);
+        store_transposition(node, key);
+      }
+      return;
+    }
+    ChildrenBuilder<N, D, Config> builder;
+    bag<Embryo<N, D, M>> embryos;
+    bag<BoardNode<N, D, M>> children;
+    {
+      lock_guard lock(tree_mutex);
+      if (solution.is_full()) {
+        return;
+      }
+      embryos = builder.get_embryos(board_node);
+      children = builder.build_children(solution, nodes_created, embryos);
+    }
+    vector<pair<typename MoveOrdering<N, D>::Score, int>> order;
+    for (int i = 0; i < static_cast<int>(children.size()); i++) {
+      order.emplace_back(traversal.ordering.score(current_state, turn, node->get_depth(),
+          embryos[i].pos, embryos[i].accumulation_point), i);
+    }
+    sort(begin(order), end(order), greater<>());
+    auto settles = [&](int i) {
+      auto child = children[i].node;
+      return child->is_final() && is_final(child->get_value(), turn);
+    };
+    search_task(children[order[0].second], counters);
+    bool early = settles(order[0].second);
+    if (!early && order.size() > 1) {
+      tbb::task_group siblings;
+      atomic<bool> settled = false;
+      for (int k = 1; k < static_cast<int>(order.size()); k++) {
+        siblings.run([&, i = order[k].second]() {
+          search_task(children[i], counters);
+          if (settles(i)) {
+            settled.store(true, memory_order_relaxed);
+            siblings.cancel();
+          }
+        });
+      }
+      siblings.wait();
+      early = settled.load(memory_order_relaxed);
+    }
+    if (early) {
+      for (const auto& child : children) {
+        if (!child.node->is_final()) {
+          child.node->set_reason(Reason::PRUNING);
+        }
+      }
+    }
+    auto [new_value, is_settled] = get_updated_parent_value({}, node, turn);
+    if (new_value.has_value() || is_settled) {
+      auto reason = early ? Reason::MINIMAX_EARLY : Reason::MINIMAX_COMPLETE;
+      settle_task(node, new_value.value_or(node->get_value()), reason, is_settled, counters);
+    }
+  }
+
+  // The checks of check_terminal_node, without writing to the tree.
+  optional<pair<BoardValue, Reason>> evaluate_task(
+      const State<N, D>& current_state, Turn turn, TranspositionKey key) {
+    if (is_win_state(current_state)) {
+      return make_pair(winner(turn), Reason::WIN);
+    }
+    if (auto first = probe_transposition(key); first != nullptr) {
+      atomic_thread_fence(memory_order_acquire);
+      if (first->is_final()) {
+        return make_pair(first->get_value(), Reason::ZOBRIST);
+      }
+    }
+    return evaluate_node(current_state, turn);
+  }
+
+  void settle_task(Node<M> *node, BoardValue value, Reason reason, bool is_final, TaskCounters& counters) {
+    node->set_reason(reason);
+    node->set_value(value);
+    if (!node->is_final() && is_final) {
+      counters.final.fetch_add(1, memory_order_relaxed);
+    }
+    node->set_is_final(is_final);
+  }
+
+  BoardNode<N, D, M> select() {
+    ScopedTimer<timed> timer(Phase::SELECT);
+    return traversal.pop_best(solution, nodes_created, config);
+  }
+
+  auto select_batch() {
+    ScopedTimer<timed> timer(Phase::SELECT);
+    return traversal.pop_batch(solution, nodes_created, config);
+  }
+
+  void retire(const BoardNode<N, D, M>& board_node, bool is_terminal) {
+    ScopedTimer<timed> timer(Phase::RETIRE);
+    traversal.retire(board_node, is_terminal);
+  }
+
   void log_stats(const BoardNode<N, D, M>& node) {
     if (node.node->get_reason() == Reason::ZOBRIST) {
       running_zobrist++;
     }
-    if (config.should_log_evolution) {
-      ofevolution << solution.get_root()->get_proof() << " " <<  solution.get_root()->get_disproof() << " "
-                  << node.node->get_depth() << " " << running_zobrist << " " << running_final << "\n";
+    if constexpr (config.should_log_evolution) {
+      auto root = solution.get_root();
+      evolution.log(EvolutionRecord{static_cast<uint32_t>(nodes_visited),
+          static_cast<uint32_t>(root->get_proof()), static_cast<uint32_t>(root->get_disproof()),
+          static_cast<uint32_t>(node.node->get_depth()), static_cast<uint32_t>(running_zobrist),
+          static_cast<uint32_t>(running_final)});
     }
   }
 
   bool process_node(const BoardNode<N, D, M>& board_node) {
+    return process_node(board_node, [&]() {
+      return evaluate_node(board_node.current_state, board_node.turn);
+    });
+  }
+
+  template<typename E>
+  bool process_node(const BoardNode<N, D, M>& board_node, E evaluate) {
     auto& [current_state, turn, node] = board_node;
     report_progress(board_node);
-    if (node->some_parent_final()) {
+    metrics.count_visit(node->get_depth());
+    // Shared nodes are reached through other parents than their own.
+    if (node->some_parent_final() && !deduplicate) {
       node->set_reason(Reason::PRUNING);
+      metrics.count_reason(Reason::PRUNING);
       return false;
     }
-    auto terminal_node = check_terminal_node(current_state, turn, node);
+    auto terminal_node = check_terminal_node(current_state, turn, node, evaluate);
     if (terminal_node.has_value()) {
       return true;
     }
+    // A shared transposition is searched below the first node of its chain.
+    if (node->get_reason() == Reason::ZOBRIST) {
+      return false;
+    }
+    if (deduplicate) {
+      store_transposition(node, TranspositionKey{current_state.get_zobrist(), current_state.get_signature()});
+    }
+    metrics.count_expansion(node->get_depth());
     traversal.push_parent(board_node, solution, nodes_created, config);
     return false;
   }
 
   optional<BoardValue> check_terminal_node(
       const State<N, D>& current_state, Turn turn, Node<M> *node) {
-    Zobrist zob = current_state.get_zobrist();
+    return check_terminal_node(current_state, turn, node, [&]() {
+      return evaluate_node(current_state, turn);
+    });
+  }
+
+  template<typename E>
+  optional<BoardValue> check_terminal_node(
+      const State<N, D>& current_state, Turn turn, Node<M> *node, E evaluate) {
+    TranspositionKey zob{current_state.get_zobrist(), current_state.get_signature()};
     if (nodes_visited > config.max_visited) {
       return save_node(node, zob, BoardValue::UNKNOWN, Reason::OUT_OF_NODES, turn);
     }
-    if (current_state.get_win_state()) {
+    if (is_win_state(current_state)) {
       return save_node(node, zob, winner(turn), Reason::WIN, turn);
     }
-    if (auto has_zobrist = zobrist.find(zob); has_zobrist != zobrist.end()) {
-      return save_node(node, zob, has_zobrist->second->get_value(), Reason::ZOBRIST, turn);
+    if (auto has_zobrist = probe_transposition(zob); has_zobrist != nullptr) {
+      if (!has_zobrist->is_final()) {
+        share_node(node, has_zobrist);
+        return {};
+      }
+      return save_node(node, zob, has_zobrist->get_value(), Reason::ZOBRIST, turn);
     }
-    auto open_positions = current_state.get_open_positions(to_mark(turn));
+    if (auto evaluation = evaluate(); evaluation.has_value()) {
+      return save_node(node, zob, evaluation->first, evaluation->second, turn);
+    }
+    return {};
+  }
+
+  bool is_win_state(const State<N, D>& current_state) {
+    ScopedTimer<timed> timer(Phase::WIN);
+    return current_state.get_win_state();
+  }
+
+  Node<M> *probe_transposition(TranspositionKey key) {
+    ScopedTimer<timed> timer(Phase::ZOBRIST);
+    return find_transposition(key);
+  }
+
+  // The checks that only read the state, safe to run from several threads.
+  optional<pair<BoardValue, Reason>> evaluate_node(const State<N, D>& current_state, Turn turn) {
+    if (tablebase != nullptr) {
+      ScopedTimer<timed> timer(Phase::TABLEBASE);
+      if (auto exact = tablebase->probe(current_state); exact.has_value()) {
+        return make_pair(*exact, Reason::TABLEBASE);
+      }
+    }
+    auto open_positions = [&]() {
+      ScopedTimer<timed> timer(Phase::DRAW);
+      return current_state.get_open_positions(to_mark(turn));
+    }();
     if (open_positions.none()) {
-      return save_node(node, zob, BoardValue::DRAW, Reason::DRAW, turn);
+      return make_pair(BoardValue::DRAW, Reason::DRAW);
     }
-    if (auto forced = check_chaining_strategy(current_state, turn); forced.has_value()) {
-      return save_node(node, zob, *forced, Reason::CHAINING, turn);
+    if constexpr (ChainingOf<Config>::enabled) {
+      if (auto forced = check_chaining_strategy(current_state, turn); forced.has_value()) {
+        return make_pair(*forced, Reason::CHAINING);
+      }
     }
     if (auto forced = check_forced_win(current_state, turn, open_positions); forced.has_value()) {
-      return save_node(node, zob, *forced, Reason::FORCED_WIN, turn);
+      return make_pair(*forced, Reason::FORCED_WIN);
     }
     return {};
   }
 
-  BoardValue save_node(Node<M> *node, optional<Zobrist> node_zobrist,
+  Node<M> *find_transposition(TranspositionKey key) {
+    auto index = transposition.find(key);
+    return index.has_value() ? solution.at(*index) : nullptr;
+  }
+
+  BoardValue save_node(Node<M> *node, optional<TranspositionKey> node_zobrist,
       BoardValue value, Reason reason, Turn turn, bool is_final = true) {
+    set_node_value(node, value, reason, is_final);
+    if (node_zobrist.has_value()) {
+      // The head found by the evaluation may have been evicted since, by a
+      // store of an earlier leaf in the same batch. The node then starts a
+      // chain of its own, which is safe since its value is already known.
+      auto first = reason == Reason::ZOBRIST ? find_transposition(*node_zobrist) : nullptr;
+      if (first != nullptr) {
+        link_transposition(node, first);
+      } else {
+        store_transposition(node, *node_zobrist);
+      }
+    }
+    update_parents(node);
+    return value;
+  }
+
+  // Nodes closer to the root stand for more work, so they are kept longer
+  // when a bucket is full.
+  void store_transposition(Node<M> *node, TranspositionKey key) {
+    auto priority = static_cast<uint16_t>(board_size - node->get_depth());
+    transposition.store(key, solution.index_of(node), priority);
+  }
+
+  void link_transposition(Node<M> *node, Node<M> *first) {
+    node->set_zobrist_next(first->get_zobrist_next());
+    node->set_zobrist_first(first);
+    first->set_zobrist_next(node);
+  }
+
+  // Only nodes that were expanded with deduplication on are stored before
+  // they are solved. The node keeps no children and no value of its own;
+  // its parents read the first node of the chain in its place.
+  void share_node(Node<M> *node, Node<M> *first) {
+    node->set_reason(Reason::ZOBRIST);
+    node->set_proof(first->get_proof());
+    node->set_disproof(first->get_disproof());
+    link_transposition(node, first);
+  }
+
+  void set_node_value(Node<M> *node, BoardValue value, Reason reason, bool is_final) {
     node->set_reason(reason);
     node->set_value(value);
     if (!node->is_final() && is_final) {
       running_final++;
+      metrics.count_reason(reason);
     }
     node->set_is_final(is_final);
-    if (node_zobrist.has_value()) {
-      if (reason == Reason::ZOBRIST) {
-        node->set_zobrist_next(zobrist[*node_zobrist]->get_zobrist_next());
-        node->set_zobrist_first(zobrist[*node_zobrist]);
-        zobrist[*node_zobrist]->set_zobrist_next(node);
-      } else {
-        zobrist[*node_zobrist] = node;
-      }
-    }
-    if (node->has_parent()) {
-      for (auto sibling = node->get_zobrist_first(); sibling != nullptr; sibling = sibling->get_zobrist_next()) {
-        update_parent_node(node, sibling->get_parent(), {}, value, reason, turn, is_final);
-      }
-    }
-    return value;
   }
 
-  void update_parent_node(
-      Node<M> *node, Node<M> *parent, Zobrist node_zobrist,
-      BoardValue value, Reason reason, Turn turn, bool is_final = true) {
-    auto parent_turn = flip(turn);
-    auto [new_parent_value, parent_is_final] = get_updated_parent_value(value, parent, parent_turn);
-    bool old_is_final = parent->is_final();
-    bool should_update = new_parent_value.has_value() || parent_is_final != old_is_final;
-    if (should_update) {
-      bool is_early = new_parent_value.has_value() && parent_is_final && !old_is_final;
-      auto parent_reason = is_early ?
-          Reason::MINIMAX_EARLY : Reason::MINIMAX_COMPLETE;
-      auto updated_parent_value = new_parent_value.value_or(parent->get_value());
-      save_node(parent, {}, updated_parent_value, parent_reason, flip(turn), parent_is_final);
+  // Backs up the value and finality of a node. Parents shared through
+  // transpositions are recomputed once, after all their changed children,
+  // and parents that do not change stop the walk.
+  void update_parents(Node<M> *node) {
+    ScopedTimer<timed> timer(Phase::BACKUP);
+    dirty.push_parents(node);
+    while (!dirty.empty()) {
+      auto parent = dirty.pop();
+      auto [new_parent_value, parent_is_final] =
+          get_updated_parent_value(node->get_value(), parent, parent->get_turn());
+      bool old_is_final = parent->is_final();
+      bool should_update = new_parent_value.has_value() || parent_is_final != old_is_final;
+      if (should_update) {
+        bool is_early = new_parent_value.has_value() && parent_is_final && !old_is_final;
+        auto parent_reason = is_early ?
+            Reason::MINIMAX_EARLY : Reason::MINIMAX_COMPLETE;
+        auto updated_parent_value = new_parent_value.value_or(parent->get_value());
+        set_node_value(parent, updated_parent_value, parent_reason, parent_is_final);
+        dirty.push_parents(parent);
+      }
     }
   }
 
@@ -222,24 +836,39 @@ class MiniMax {
     }
   }
 
-  template<typename T>
-  bool is_final_candidate(T& children, optional<BoardValue> new_value) {
-    return find_if(begin(children), end(children), [&](const auto& child) {
-      return child.second->get_value() == new_value && child.second->is_final();
-    }) != end(children);
-  }
-
+  // Finds the best value of a parent and whether it is final in a single
+  // pass over its children.
   pair<optional<BoardValue>, bool> get_updated_parent_value(
       optional<BoardValue> child_value,
       const Node<M> *parent,
       Turn parent_turn) {
     assert(child_value != BoardValue::UNKNOWN);
-    auto children = parent->get_children();
-    auto new_value = parent_turn == Turn::X ? parent->best_child_X() : parent->best_child_O();
-    bool final_candidate = is_final_candidate(children, new_value);
-    bool all_children_final = all_of(begin(children), end(children), [&](const auto& child) {
-      return child.second->is_final();
-    });
+    optional<BoardValue> lowest, highest;
+    unsigned final_values = 0;
+    bool all_children_final = true;
+    for (const auto& [pos, child] : parent->get_children()) {
+      auto value = child->get_value();
+      if (child->is_final()) {
+        final_values |= 1u << static_cast<int>(value);
+      } else {
+        all_children_final = false;
+      }
+      if (value != BoardValue::UNKNOWN) {
+        lowest = lowest.has_value() ? min(*lowest, value) : value;
+        highest = highest.has_value() ? max(*highest, value) : value;
+      }
+    }
+    auto has_final = [&](BoardValue value) {
+      return (final_values >> static_cast<int>(value)) & 1;
+    };
+    auto new_value = lowest;
+    if (parent_turn == Turn::O) {
+      // O settles for a final draw over an O win that is not final.
+      bool draw_settles = highest > BoardValue::DRAW &&
+          has_final(BoardValue::DRAW) && !has_final(BoardValue::O_WIN);
+      new_value = draw_settles ? BoardValue::DRAW : highest;
+    }
+    bool final_candidate = new_value.has_value() && has_final(*new_value);
     bool parent_is_final = all_children_final ||
         (final_candidate && is_final(*new_value, parent_turn));
     if (new_value != parent->get_value()) {
@@ -257,18 +886,26 @@ class MiniMax {
       double value = solution.get_root()->work;
       ostringstream oss;
       oss << setprecision(2) << value * 100.0;
-      config.debug << "done : "s << oss.str() << "%\n"s;
+      config.debug << "done : "s << oss.str() << "%\t"s;
+      config.debug << get_memory().summary() << "\n"s;
     }
     nodes_visited++;
   }
 
   optional<BoardValue> check_chaining_strategy(const State<N, D>& current_state, Turn turn) {
+    ScopedTimer<timed> timer(Phase::CHAINING);
     auto c = ChainingStrategy(current_state);
     auto pos = c.search(to_mark(turn));
-    static int max_visited = 0;
-    if (c.visited > max_visited) {
-      max_visited = c.visited;
-      config.debug << "new record "s << max_visited << "\n"s;
+    metrics.count_chaining(c.visited);
+    int clones = chaining_clones.load(memory_order_relaxed);
+    while (c.max_clones > clones && !chaining_clones.compare_exchange_weak(clones, c.max_clones)) {
+    }
+    int record = chaining_record.load(memory_order_relaxed);
+    while (c.visited > record) {
+      if (chaining_record.compare_exchange_weak(record, c.visited)) {
+        config.debug << "new record "s << c.visited << "\n"s;
+        break;
+      }
     }
     if (pos.has_value()) {
       return winner(turn);
@@ -278,6 +915,7 @@ class MiniMax {
 
   template<typename B>
   optional<BoardValue> check_forced_win(const State<N, D>& current_state, Turn turn, const B& open_positions) {
+    ScopedTimer<timed> timer(Phase::FORCED_WIN);
     auto s = ForcingMove<N, D>(current_state);
     auto forcing = s.check(to_mark(turn), open_positions);
     if (forcing.first.has_value()) {
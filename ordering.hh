@@ -0,0 +1,91 @@
+#ifndef ORDERING_HH
+#define ORDERING_HH
+
+#include <array>
+#include <tuple>
+#include <algorithm>
+#include "boarddata.hh"
+#include "state.hh"
+
+// Move ordering for the depth-first traversals. Moves are ranked by threat,
+// static weight, killer and history, in that order. The dynamic heuristics
+// learn from the moves that decided their parent early, and only break
+// ties, since on 4x4 they lose to the static weight when put first.
+template<int N, int D>
+class MoveOrdering {
+ public:
+  constexpr static Position board_size = BoardData<N, D>::board_size;
+  enum Heuristic : unsigned {
+    HISTORY = 1,
+    KILLER = 2,
+    THREAT = 4,
+    ALL = HISTORY | KILLER | THREAT
+  };
+  using Score = tuple<int, int, int, unsigned>;
+
+  explicit MoveOrdering(const BoardData<N, D>& data) : data(data) {
+    clear();
+  }
+
+  void set_heuristics(unsigned mask) {
+    heuristics = mask;
+  }
+
+  void clear() {
+    for (auto& table : history) {
+      table.fill(0);
+    }
+    for (auto& slots : killers) {
+      slots.fill(no_move);
+    }
+  }
+
+  // Larger scores are tried first.
+  Score score(const State<N, D>& state, Turn turn, int depth, Position pos, LineCount static_weight) const {
+    int killer = 0;
+    if (heuristics & KILLER) {
+      killer = killers[depth][0] == pos ? 2 : killers[depth][1] == pos ? 1 : 0;
+    }
+    int threat = (heuristics & THREAT) ? count_threats(state, to_mark(turn), pos) : 0;
+    unsigned past = (heuristics & HISTORY) ? history[turn_index(turn)][pos] : 0u;
+    return {threat, static_cast<int>(static_weight), killer, past};
+  }
+
+  // Credits a move that settled its parent before all siblings were tried.
+  void reward(Turn turn, int depth, Position pos) {
+    int remaining = board_size - depth;
+    history[turn_index(turn)][pos] += static_cast<unsigned>(remaining * remaining);
+    auto& slots = killers[depth];
+    if (slots[0] != pos) {
+      slots[1] = slots[0];
+      slots[0] = pos;
+    }
+  }
+
+ private:
+  constexpr static Position no_move = Position{board_size};
+  const BoardData<N, D>& data;
+  unsigned heuristics = ALL;
+  array<array<unsigned, board_size>, 2> history;
+  array<array<Position, 2>, board_size + 2> killers;
+
+  static int turn_index(Turn turn) {
+    return turn == Turn::X ? 0 : 1;
+  }
+
+  // Lines through the cell that hold N - 2 marks of a single side. The move
+  // turns such a line of its own into a threat, and keeps one of the
+  // opponent from becoming a threat.
+  int count_threats(const State<N, D>& state, Mark mark, Position pos) const {
+    int threats = 0;
+    for (Line line : data.lines_through_position()[pos]) {
+      if (state.check_line(line, MarkCount{N - 2}, mark) ||
+          state.check_line(line, MarkCount{N - 2}, flip(mark))) {
+        threats++;
+      }
+    }
+    return threats;
+  }
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef PN2_HH
+#define PN2_HH
+
+#include <memory>
+#include "minimax.hh"
+
+template<int S>
+struct SecondLevelConfig {
+  constexpr static NodeCount max_visited = NodeCount{S};
+  constexpr static NodeCount max_created = NodeCount{S};
+  DummyCout debug;
+  bool should_log_evolution = false;
+  bool should_prune = false;
+  size_t transposition_bytes = 64 << 10;
+};
+
+// PN² search. The first level is a regular proof-number search, but each
+// frontier node is expanded by a second-level search bounded to S nodes.
+// Only the children of the frontier node are kept in the first-level tree,
+// seeded with the proof numbers estimated by the second level; the rest of
+// the second-level tree is discarded. The second level runs df-pn on its
+// own tree, since it is rooted at an arbitrary position and df-pn never
+// rebuilds states from the root. A single second-level search is reset for
+// every frontier node, so its tree and table are only allocated once.
+template<int N, int D, int M, int S = 4096>
+class PN2Search : public PNSearch<N, D, M> {
+  using Base = PNSearch<N, D, M>;
+  using SecondLevel = MiniMax<N, D, DFPNSearch<N, D, S>, SecondLevelConfig<S>>;
+ public:
+  explicit PN2Search(const BoardData<N, D>& data, Node<M> *root)
+      : Base(data, root), start(data), second(make_unique<SecondLevel>(start, data)),
+        estimates(BoardData<N, D>::board_size) {
+  }
+  template<typename Config>
+  void push_parent(BoardNode<N, D, M> board_node, SolutionTree<M>& solution, int &nodes_created, Config& config) {
+    auto& [current_state, turn, node] = board_node;
+    State<N, D> state = current_state;
+    second->reset();
+    second->play(state, turn);
+    ChildrenBuilder<N, D, Config> builder;
+    auto embryos = builder.get_embryos(board_node);
+    builder.build_children(solution, nodes_created, embryos);
+    auto second_root = second->get_solution().get_root();
+    if (!second_root->has_children()) {
+      return;
+    }
+    // The children are matched by position, not by their order in each tree.
+    fill(begin(estimates), end(estimates), nullptr);
+    for (int i = 0; i < second_root->get_position_count(); i++) {
+      estimates[second_root->get_position_at(i)] = second_root->get_child(i);
+    }
+    for (const auto& embryo : embryos) {
+      auto child = embryo.child();
+      auto estimate = estimates[embryo.pos];
+      if (child != nullptr && estimate != nullptr) {
+        child->set_proof(bounded(estimate->get_proof()));
+        child->set_disproof(bounded(estimate->get_disproof()));
+      }
+    }
+  }
+ private:
+  // The second level is built once, and its unused root state must outlive
+  // it.
+  State<N, D> start;
+  unique_ptr<SecondLevel> second;
+  vector<Node<S> *> estimates;
+
+  // A child only counts as solved once the first level evaluates it, so
+  // the estimates are kept strictly between 0 and infinity.
+  static ProofNumber bounded(ProofNumber value) {
+    return clamp(value, 1_pn, ProofNumber{Node<M>::INFTY - 1});
+  }
+};
+
+#endif
@@ -1,31 +1,68 @@
-import matplotlib.pyplot as plot
-import pandas as pd
+import struct
+import sys
 
-pn = [x.split() for x in open("pnevolution.txt", "rt").readlines()]
-fig, (ax1, ax2, ax3) = plot.subplots(3)
-proof = [int(x[0]) for x in pn]
-disproof = [int(x[1]) for x in pn]
-pproof = pd.DataFrame(proof)
-pdisproof = pd.DataFrame(disproof)
-ax1.plot(pproof.rolling(20).mean(), label="proof")
-ax1.plot(pdisproof.rolling(20).mean(), label="disproof")
-ax1.set(xlabel="Nodes visited", ylabel="Proof number")
-ax1.legend()
-depth = [float(x[2]) for x in pn]
-m = 1000
-smooth = [sum(depth[i:i+m])/m for i in range(len(depth)-m)]
-upper_bound = [max(smooth[i:i+m]) for i in range(len(smooth)-m)]
-lower_bound = [min(smooth[i:i+m]) for i in range(len(smooth)-m)]
-#ax2.plot(depth, label="depth")
-ax2.plot(upper_bound, label="upper bound")
-ax2.plot(lower_bound, label="lower bound")
-ax2.set(xlabel="Nodes visited", ylabel="Depth")
-ax2.legend()
-size = len(pn)
-zobrist = [float(x[3])/size*100 for x in pn]
-final = [float(x[4])/size*100 for x in pn]
-ax3.plot(zobrist, label="Zobrist")
-ax3.plot(final, label="Final")
-ax3.set(xlabel="Nodes visited", ylabel="Percentage of nodes")
-ax3.legend()
-plot.show()
+# The records of EvolutionTrace in trace.hh, after a header of magic,
+# version and record size.
+HEADER = struct.Struct("<III")
+RECORD = struct.Struct("<IIIIII")
+MAGIC = 0x56454e50
+FIELDS = ["visited", "proof", "disproof", "depth", "zobrist", "final"]
+
+def read_trace(filename):
+  with open(filename, "rb") as f:
+    data = f.read()
+  magic, version, size = HEADER.unpack_from(data)
+  if magic != MAGIC or size != RECORD.size:
+    raise ValueError("%s is not an evolution trace" % filename)
+  records = data[HEADER.size:]
+  records = records[:len(records) - len(records) % RECORD.size]
+  return list(RECORD.iter_unpack(records))
+
+def write_text(trace, filename):
+  with open(filename, "wt") as f:
+    f.write(" ".join(FIELDS) + "\n")
+    for record in trace:
+      f.write(" ".join(str(x) for x in record) + "\n")
+
+def plot_trace(trace):
+  import matplotlib.pyplot as plot
+  import pandas as pd
+  fig, (ax1, ax2, ax3) = plot.subplots(3)
+  visited = [x[0] for x in trace]
+  proof = [x[1] for x in trace]
+  disproof = [x[2] for x in trace]
+  pproof = pd.DataFrame(proof, index=visited)
+  pdisproof = pd.DataFrame(disproof, index=visited)
+  ax1.plot(pproof.rolling(20).mean(), label="proof")
+  ax1.plot(pdisproof.rolling(20).mean(), label="disproof")
+  ax1.set(xlabel="Nodes visited", ylabel="Proof number")
+  ax1.legend()
+  depth = [float(x[3]) for x in trace]
+  m = min(1000, max(len(depth) // 10, 1))
+  smooth = [sum(depth[i:i+m])/m for i in range(len(depth)-m)]
+  upper_bound = [max(smooth[i:i+m]) for i in range(len(smooth)-m)]
+  lower_bound = [min(smooth[i:i+m]) for i in range(len(smooth)-m)]
+  ax2.plot(upper_bound, label="upper bound")
+  ax2.plot(lower_bound, label="lower bound")
+  ax2.set(xlabel="Samples", ylabel="Depth")
+  ax2.legend()
+  size = visited[-1]
+  zobrist = [float(x[4])/size*100 for x in trace]
+  final = [float(x[5])/size*100 for x in trace]
+  ax3.plot(visited, zobrist, label="Zobrist")
+  ax3.plot(visited, final, label="Final")
+  ax3.set(xlabel="Nodes visited", ylabel="Percentage of nodes")
+  ax3.legend()
+  plot.show()
+
+# Usage: pnevolution.py [trace] [text output]
+# With an output file the trace is converted to text instead of plotted.
+def main():
+  trace = read_trace(sys.argv[1] if len(sys.argv) >= 2 else "pnevolution.bin")
+  if len(sys.argv) >= 3:
+    write_text(trace, sys.argv[2])
+  else:
+    plot_trace(trace)
+
+if __name__ == '__main__':
+  main()
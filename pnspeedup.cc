@@ -0,0 +1,96 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <tbb/info.h>
+#include "minimax.hh"
+#include "alphabeta.hh"
+
+struct SpeedupConfig {
+  constexpr static NodeCount max_visited = 10'000'000_nc;
+  constexpr static NodeCount max_created = 10'000'000_nc;
+  DummyCout debug;
+  bool should_prune = false;
+  bool should_log_evolution = false;
+  size_t transposition_bytes = 256 << 20;
+};
+
+template<int N, int D, template<int, int, int> typename Traversal>
+void measure_speedup(const vector<int>& thread_counts) {
+  using Search = Traversal<N, D, SpeedupConfig::max_created>;
+  BoardData<N, D> data;
+  double base_time = 0.0;
+  int base_nodes = 0;
+  cout << "threads\ttime(s)\tspeedup\tvisited\tcreated\tnode efficiency\tresult\n";
+  for (int threads : thread_counts) {
+    State state(data);
+    auto minimax = make_unique<MiniMax<N, D, Search, SpeedupConfig>>(state, data);
+    minimax->traversal.set_threads(threads);
+    auto start = chrono::steady_clock::now();
+    auto result = minimax->play(state, Turn::X);
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    if (base_nodes == 0) {
+      base_time = elapsed.count();
+      base_nodes = minimax->nodes_visited;
+    }
+    cout << threads << "\t" << setprecision(3) << elapsed.count() << "\t"
+         << base_time / elapsed.count() << "\t" << minimax->nodes_visited << "\t"
+         << minimax->nodes_created << "\t"
+         << static_cast<double>(base_nodes) / minimax->nodes_visited << "\t\t"
+         << result << "\n";
+  }
+}
+
+template<int N, int D>
+void measure_alphabeta_speedup(const vector<int>& thread_counts) {
+  BoardData<N, D> data;
+  double base_time = 0.0;
+  int base_nodes = 0;
+  cout << "threads\ttime(s)\tspeedup\tvisited\tnode efficiency\tresult\n";
+  for (int threads : thread_counts) {
+    State state(data);
+    auto alphabeta = make_unique<AlphaBeta<N, D>>(data, SpeedupConfig{}.transposition_bytes);
+    alphabeta->set_threads(threads);
+    auto start = chrono::steady_clock::now();
+    auto result = alphabeta->solve(state, Turn::X);
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    if (base_nodes == 0) {
+      base_time = elapsed.count();
+      base_nodes = alphabeta->nodes_visited;
+    }
+    cout << threads << "\t" << setprecision(3) << elapsed.count() << "\t"
+         << base_time / elapsed.count() << "\t" << alphabeta->nodes_visited << "\t"
+         << static_cast<double>(base_nodes) / alphabeta->nodes_visited << "\t\t"
+         << result << "\n";
+  }
+}
+
+template<int N, int D>
+void measure(const vector<int>& thread_counts, const string& search) {
+  if (search == "alphabeta") {
+    measure_alphabeta_speedup<N, D>(thread_counts);
+  } else if (search == "dfs") {
+    measure_speedup<N, D, ParallelDFS>(thread_counts);
+  } else {
+    measure_speedup<N, D, ParallelPNSearch>(thread_counts);
+  }
+}
+
+int main(int argc, char **argv) {
+  string board = argc >= 2 ? argv[1] : "33";
+  string search = argc >= 3 ? argv[2] : "pn";
+  vector<int> thread_counts{1, 2, 4, 8, 16};
+  if (int cores = tbb::info::default_concurrency(); cores < 2) {
+    cout << "only " << cores << " core available, the speedups measure overhead only\n";
+  }
+  if (board == "33") {
+    measure<3, 3>(thread_counts, search);
+  } else if (board == "42") {
+    measure<4, 2>(thread_counts, search);
+  } else if (board == "43") {
+    measure<4, 3>(thread_counts, search);
+  } else {
+    cout << "unsupported board " << board << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -7,4 +7,5 @@
     WIN,
     PRUNING,
     CHAINING,
-    UNKNOWN
+    UNKNOWN,
+    TABLEBASE
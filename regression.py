@@ -0,0 +1,77 @@
+import argparse
+import json
+import subprocess
+import sys
+
+# Solves every board and traversal with fixed budgets and compares the
+# results against a stored baseline.
+MATRIX = [
+  ("32", "dfs"), ("32", "bfs"), ("32", "pn"),
+  ("33", "dfs"), ("33", "bfs"), ("33", "pn"),
+  ("42", "dfs"), ("42", "pn"),
+]
+
+# The search is deterministic, so these must match the baseline exactly.
+EXACT = ["value", "nodes_visited", "nodes_created"]
+
+# Time and memory depend on the machine, so they are only printed unless
+# --timing asks to compare them. Lower is better for both.
+MEASURES = ["seconds", "peak_rss_kb"]
+
+# Runs this short are mostly noise, so their time is not compared.
+MIN_SECONDS = 0.05
+
+def run(board, traversal):
+  output = subprocess.run(
+      ["./minimax", "--board", board, "--traversal", traversal, "--json"],
+      capture_output=True, text=True, check=True).stdout
+  return json.loads(output.strip().splitlines()[-1])
+
+def compare(baseline, result, threshold, timing):
+  problems = []
+  for field in EXACT:
+    if result[field] != baseline[field]:
+      problems.append("%s %s, was %s" % (field, result[field], baseline[field]))
+  if not result["valid"]:
+    problems.append("solution does not validate")
+  if not timing:
+    return problems
+  for measure in MEASURES:
+    old, new = baseline[measure], result[measure]
+    if measure == "seconds" and old < MIN_SECONDS:
+      continue
+    if old > 0 and new > old * (1 + threshold):
+      problems.append("%s %s, was %s (+%.0f%%)" % (measure, new, old, (new / old - 1) * 100))
+  return problems
+
+def main():
+  parser = argparse.ArgumentParser()
+  parser.add_argument("--baseline", default="regression.json")
+  parser.add_argument("--threshold", type=float, default=0.1)
+  parser.add_argument("--timing", action="store_true",
+                      help="also fail when time or memory grow past the threshold")
+  parser.add_argument("--save", action="store_true", help="store the results as the new baseline")
+  args = parser.parse_args()
+  results = [run(board, traversal) for board, traversal in MATRIX]
+  if args.save:
+    with open(args.baseline, "wt") as f:
+      json.dump(results, f, indent=2)
+      f.write("\n")
+    return 0
+  with open(args.baseline, "rt") as f:
+    baseline = {(r["board"], r["traversal"]): r for r in json.load(f)}
+  failed = False
+  for result in results:
+    key = (result["board"], result["traversal"])
+    name = "%s %s" % key
+    if key not in baseline:
+      print("%-8s new, no baseline" % name)
+      continue
+    problems = compare(baseline[key], result, args.threshold, args.timing)
+    failed |= bool(problems)
+    measured = ", ".join("%s %s (was %s)" % (m, result[m], baseline[key][m]) for m in MEASURES)
+    print("%-8s %s [%s]" % (name, "; ".join(problems) if problems else "ok", measured))
+  return 1 if failed else 0
+
+if __name__ == '__main__':
+  sys.exit(main())
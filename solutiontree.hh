@@ -63,6 +63,8 @@ class DotDumper {
 template<int M>
 class SolutionTree {
  public:
+  constexpr static uint32_t no_node = numeric_limits<uint32_t>::max();
+
   Node<M> *get_root() {
     return root;
   }
@@ -100,21 +102,265 @@ class SolutionTree {
     update_count(root);
   }
 
+  uint32_t index_of(const Node<M> *node) const {
+    return Node<M>::Arena::handle_of(node);
+  }
+
+  Node<M> *at(uint32_t index) {
+    return &nodes[index];
+  }
+
+  uint32_t size() const {
+    return nodes.size();
+  }
+
+  bool is_full() const {
+    return nodes.is_full();
+  }
+
+  // The node budget can be changed at any time; chunks are only allocated
+  // when the tree grows into them.
+  void set_budget(size_t budget) {
+    nodes.set_budget(budget);
+  }
+
+  // Lets several threads read the tree while one of them, holding a lock,
+  // adds nodes up to the budget.
+  void reserve() {
+    nodes.reserve();
+  }
+
+  size_t memory_bytes() const {
+    return nodes.memory_bytes();
+  }
+
+  // The nodes and the child arrays, which live in separate arenas.
+  size_t node_bytes() const {
+    return nodes.ChunkedArena<Node<M>>::memory_bytes();
+  }
+
+  size_t children_bytes() const {
+    return nodes.slabs.memory_bytes();
+  }
+
+  // Prunes the children that do not take part in the proof of final nodes,
+  // then compacts the arena keeping only the nodes reachable from the root.
+  // When the first node of a zobrist chain is dropped, its first live
+  // referrer takes its place as the head of the chain. Returns the new index
+  // of each old node, with dropped heads forwarded to their replacement and
+  // the other dropped nodes set to no_node.
+  vector<uint32_t> collect() {
+    vector<Reason> reason(nodes.size());
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+      reason[i] = nodes[i].get_reason();
+    }
+    prune();
+    vector<bool> live(nodes.size(), false);
+    mark_live(root, live);
+    vector<uint32_t> forward(nodes.size(), no_node);
+    uint32_t size = 0;
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+      if (live[i]) {
+        forward[i] = size++;
+      }
+    }
+    vector<Node<M>*> head(nodes.size(), nullptr);
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+      auto first = nodes[i].get_zobrist_first();
+      if (live[i] && !live[index_of(first)] && head[index_of(first)] == nullptr) {
+        auto next = first->get_zobrist_next();
+        while (!live[index_of(next)]) {
+          next = next->get_zobrist_next();
+        }
+        head[index_of(first)] = next;
+        forward[index_of(first)] = forward[index_of(next)];
+      }
+    }
+    // Links are computed from the old handles before any node is changed.
+    struct Links {
+      uint32_t parent, zobrist_first, zobrist_next;
+    };
+    vector<Links> links(nodes.size());
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+      if (!live[i]) {
+        continue;
+      }
+      auto& node = nodes[i];
+      auto first = node.get_zobrist_first();
+      if (!live[index_of(first)]) {
+        first = head[index_of(first)];
+      }
+      auto next = node.get_zobrist_next();
+      while (next != nullptr && !live[index_of(next)]) {
+        next = next->get_zobrist_next();
+      }
+      links[i].parent = node.has_parent() ? forward[index_of(node.get_parent())] : 0;
+      links[i].zobrist_first = first == &node ? 0 : forward[index_of(first)] + 1;
+      links[i].zobrist_next = next == nullptr ? 0 : forward[index_of(next)] + 1;
+    }
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+      if (head[i] != nullptr) {
+        head[i]->set_reason(reason[i]);
+      }
+    }
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+      if (!live[i]) {
+        continue;
+      }
+      auto& node = nodes[i];
+      if (node.has_parent()) {
+        node.packed_values.parent = links[i].parent;
+      }
+      node.packed_values.zobrist_first = links[i].zobrist_first;
+      node.packed_values.zobrist_next = links[i].zobrist_next;
+      for (int j = 0; j < node.get_position_count(); j++) {
+        if (auto child = node.get_child(j); child != nullptr) {
+          node.child_handles()[j] = live[index_of(child)] ? forward[index_of(child)] : 0;
+        }
+      }
+      if (forward[i] != i) {
+        nodes[forward[i]] = move(node);
+      }
+    }
+    nodes.truncate(size);
+    SlabArena slabs;
+    for (uint32_t i = 0; i < size; i++) {
+      auto& node = nodes[i];
+      if (node.has_position()) {
+        auto words = Node<M>::slab_words(node.children_size);
+        auto offset = slabs.allocate(words);
+        copy_n(node.child_handles(), words, slabs.at(offset));
+        node.slab = offset;
+      }
+    }
+    nodes.slabs = move(slabs);
+    return forward;
+  }
+
   Node<M> *create_node(Node<M> *parent, Turn turn, int children_size) {
-    return &nodes.emplace_back(parent, turn, children_size);
+    return nodes.emplace_back(parent, turn, children_size);
+  }
+
+  // Links between nodes are arena handles, so the packed fields and the
+  // child handles are written as they are.
+  void save(ostream& os) const {
+    uint32_t size = nodes.size();
+    write(os, size);
+    for (uint32_t i = 0; i < size; i++) {
+      const auto& node = nodes[i];
+      write(os, node.packed_values);
+      write(os, node.children_size);
+      write(os, node.children_built);
+      write(os, node.work);
+      write(os, node.position_count);
+      if (node.has_position()) {
+        os.write(reinterpret_cast<const char *>(node.positions()), node.position_count);
+        os.write(reinterpret_cast<const char *>(node.child_handles()), node.position_count * sizeof(uint32_t));
+      }
+    }
   }
 
-  explicit SolutionTree(int board_size) {
-    nodes.reserve(M);
-    nodes.emplace_back(nullptr, Turn::X, board_size);
+  // Reads through a saved tree without changing this one, checking that
+  // it fits the budget and that every link points inside it.
+  bool check(istream& is) const {
+    uint32_t size = 0;
+    read(is, size);
+    if (!is || size == 0 || size > nodes.get_budget()) {
+      return false;
+    }
+    for (uint32_t i = 0; i < size; i++) {
+      decltype(Node<M>::packed_values) packed;
+      uint8_t children_size = 0, positions = 0;
+      bool children_built = false;
+      float work = 0.0f;
+      read(is, packed);
+      read(is, children_size);
+      read(is, children_built);
+      read(is, work);
+      read(is, positions);
+      if (!is || positions > children_size || packed.parent >= size
+          || packed.zobrist_first > size || packed.zobrist_next > size) {
+        return false;
+      }
+      is.ignore(positions);
+      for (int j = 0; j < positions; j++) {
+        uint32_t handle = 0;
+        read(is, handle);
+        if (handle >= size) {
+          return false;
+        }
+      }
+    }
+    return static_cast<bool>(is);
+  }
+
+  bool load(istream& is) {
+    uint32_t size = 0;
+    read(is, size);
+    if (!is || size == 0 || size > nodes.get_budget()) {
+      return false;
+    }
+    nodes.truncate(0);
+    nodes.slabs = SlabArena();
+    for (uint32_t i = 0; i < size; i++) {
+      auto& node = *nodes.emplace_back(nullptr, Turn::X, 0);
+      read(is, node.packed_values);
+      read(is, node.children_size);
+      read(is, node.children_built);
+      read(is, node.work);
+      uint8_t positions = 0;
+      read(is, positions);
+      for (int j = 0; j < positions; j++) {
+        uint8_t pos = 0;
+        read(is, pos);
+        node.add_position(Position{pos});
+      }
+      if (positions > 0) {
+        is.read(reinterpret_cast<char *>(node.child_handles()), positions * sizeof(uint32_t));
+      }
+    }
     root = &nodes[0];
+    return static_cast<bool>(is);
+  }
+
+  explicit SolutionTree(int board_size, size_t budget = M) : nodes(budget) {
+    root = nodes.emplace_back(nullptr, Turn::X, board_size);
+    root->set_is_root(true);
+  }
+
+  // Leaves a fresh root in the first slot. The memory is kept, so the new
+  // root has the same address as the old one.
+  void reset(int board_size) {
+    nodes.truncate(0);
+    nodes.slabs.clear();
+    root = nodes.emplace_back(nullptr, Turn::X, board_size);
     root->set_is_root(true);
   }
 
  private:
-  vector<Node<M>> nodes;
+  typename Node<M>::Arena nodes;
   Node<M>* root;
 
+  template<typename T>
+  static void write(ostream& os, const T& value) {
+    os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+
+  template<typename T>
+  static void read(istream& is, T& value) {
+    is.read(reinterpret_cast<char *>(&value), sizeof(value));
+  }
+
+  void mark_live(Node<M> *node, vector<bool>& live) {
+    live[index_of(node)] = true;
+    for (int i = 0; i < node->get_position_count(); i++) {
+      auto child = node->get_child(i);
+      if (child != nullptr && child->get_reason() != Reason::PRUNING) {
+        mark_live(child, live);
+      }
+    }
+  }
+
   NodeCount update_count(Node<M> *node) {
     if (!node->has_children()) {
       return node->set_count(1_nc);
@@ -198,10 +444,22 @@ class SolutionTree {
     });
   }
 
+  // Keeps a single proving child. Shared nodes may be solved through other
+  // parents after this node, so more than one child can prove it.
   void prune_children(Node<M> *node, BoardValue goal) {
-    for (int i = 0; i < static_cast<int>(node->position.size()); i++) {
+    if (!node->is_final()) {
+      return;
+    }
+    bool kept = false;
+    for (int i = 0; i < node->get_position_count(); i++) {
       Node<M> *child = node->get_child(i);
-      if (node->is_final() && (child->get_value() != goal || !child->is_final())) {
+      if (child == nullptr) {
+        continue;
+      }
+      auto target = child->get_reason() == Reason::ZOBRIST ? child->get_zobrist_first() : child;
+      if (!kept && target->get_value() == goal && target->is_final()) {
+        kept = true;
+      } else {
         child->set_reason(Reason::PRUNING);
       }
     }
@@ -211,7 +469,7 @@ class SolutionTree {
      if (node->has_children()) {
        return node->get_children();
      } else {
-       return vector<pair<Position, Node<M>*>>{};
+       return typename Node<M>::ChildrenView{};
      }
   }
 
@@ -27,6 +27,7 @@ class State {
       current_accumulation(data.accumulation_points()),
       trie_node(0_node),
       zobrist(0),
+      signature(0),
       win(false) {
   }
 
@@ -37,6 +38,16 @@ class State {
     return win;
   }
 
+  // The empty cells where some line can still be completed.
+  const TrackingList<N, D>& get_live_cells() const {
+    return empty_cells;
+  }
+
+  // Cells without a mark, dead or not. O(1).
+  int get_empty_count() const {
+    return board_size - moves;
+  }
+
   Bitfield<N, D> get_open_positions(Mark mark) const {
     Bitfield<N, D> open_positions;
     Bitfield<N, D> checked;
@@ -101,13 +112,19 @@ class State {
     return zobrist;
   }
 
+  Signature get_signature() const {
+    return signature;
+  }
+
   bool play(initializer_list<Side> pos, Mark mark) {
     return play(data.encode(pos), mark);
   }
 
   bool play(Position pos, Mark mark) {
     board[pos] = mark;
+    moves++;
     zobrist ^= data.get_zobrist(pos, mark);
+    signature ^= data.get_signature(pos, mark);
     empty_cells.remove(pos);
     trie_node = data.next(trie_node, pos);
     for (Line line : data.lines_through_position()[pos]) {
@@ -210,6 +227,8 @@ class State {
   TrackingList<N, D> empty_cells;
   Elevator<N, D> line_marks;
   Zobrist zobrist;
+  Signature signature;
+  int moves = 0;
   bool win;
 
   char encode_position(Mark pos) const {
@@ -86,6 +86,8 @@ class ChainingStrategy {
   }
   const State<N, D>& state;
   int visited = 0;
+  // Clones of the state alive at once, one per level of the chain.
+  int clones = 0, max_clones = 0;
   constexpr static Line line_size = BoardData<N, D>::line_size;
 
   template<typename B>
@@ -113,8 +115,10 @@ class ChainingStrategy {
       for (Position pos : current.get_line(line)) {
         if (current.get_board(pos) == Mark::empty) {
           State cloned(current);
+          max_clones = max(max_clones, ++clones);
           cloned.play(pos, mark);
           optional<Position> opponent = search_opponent(cloned, flip(mark));
+          clones--;
           if (opponent.has_value()) {
             return pos;
           }
@@ -0,0 +1,37 @@
+#include <iostream>
+#include <chrono>
+#include "tablebase.hh"
+
+template<int N, int D>
+void build_tablebase(int max_empty, string filename) {
+  BoardData<N, D> data;
+  Tablebase<N, D> tablebase(data);
+  auto start = chrono::steady_clock::now();
+  tablebase.build(max_empty);
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  cout << "positions indexed: " << tablebase.size() << "\n";
+  cout << "build time: " << elapsed.count() << "s\n";
+  State<N, D> state(data);
+  cout << "initial position: " << tablebase.probe(state) << "\n";
+  tablebase.save(filename);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 4) {
+    cout << "usage: tablebase <N><D> <max_empty> <file>\n";
+    return 1;
+  }
+  string board = argv[1];
+  int max_empty = atoi(argv[2]);
+  if (board == "32") {
+    build_tablebase<3, 2>(max_empty, argv[3]);
+  } else if (board == "42") {
+    build_tablebase<4, 2>(max_empty, argv[3]);
+  } else if (board == "33") {
+    build_tablebase<3, 3>(max_empty, argv[3]);
+  } else {
+    cout << "unsupported board " << board << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,323 @@
+#ifndef TABLEBASE_HH
+#define TABLEBASE_HH
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <execution>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "semantic.hh"
+#include "boarddata.hh"
+#include "state.hh"
+
+// Positions are grouped in layers by the number of empty cells. Inside a
+// layer, a position is ranked by the combinadic of its empty cells followed
+// by the combinadic of its X cells among the filled ones.
+template<int N, int D>
+class TablebaseIndex {
+ public:
+  constexpr static Position board_size = BoardData<N, D>::board_size;
+  static_assert(board_size <= 64, "tablebase index must fit in 64 bits");
+  using Board = sarray<Position, Mark, board_size>;
+
+  TablebaseIndex() {
+    for (int n = 0; n <= board_size; n++) {
+      binomial[n][0] = 1;
+      for (int k = 1; k <= n; k++) {
+        binomial[n][k] = binomial[n - 1][k - 1] + (k < n ? binomial[n - 1][k] : 0);
+      }
+    }
+  }
+
+  static int x_count(int empty) {
+    return (board_size - empty + 1) / 2;
+  }
+
+  static Turn turn(int empty) {
+    return (board_size - empty) % 2 == 0 ? Turn::X : Turn::O;
+  }
+
+  uint64_t layer_size(int empty) const {
+    return choose(board_size, empty) * choose(board_size - empty, x_count(empty));
+  }
+
+  uint64_t rank(const Board& board, int empty) const {
+    uint64_t empty_rank = 0, x_rank = 0;
+    int empty_seen = 0, filled_seen = 0, x_seen = 0;
+    for (Position pos = 0_pos; pos < board_size; ++pos) {
+      if (board[pos] == Mark::empty) {
+        empty_rank += choose(pos, ++empty_seen);
+      } else {
+        if (board[pos] == Mark::X) {
+          x_rank += choose(filled_seen, ++x_seen);
+        }
+        filled_seen++;
+      }
+    }
+    return empty_rank * choose(board_size - empty, x_count(empty)) + x_rank;
+  }
+
+  Board unrank(uint64_t rank, int empty) const {
+    Board board(Mark::O);
+    uint64_t x_size = choose(board_size - empty, x_count(empty));
+    uint64_t empty_rank = rank / x_size;
+    uint64_t x_rank = rank % x_size;
+    vector<bool> is_empty(board_size, false);
+    for (int i = empty, c = board_size - 1; i >= 1; i--) {
+      while (choose(c, i) > empty_rank) {
+        c--;
+      }
+      is_empty[c] = true;
+      empty_rank -= choose(c, i);
+    }
+    vector<Position> filled;
+    for (Position pos = 0_pos; pos < board_size; ++pos) {
+      if (is_empty[pos]) {
+        board[pos] = Mark::empty;
+      } else {
+        filled.push_back(pos);
+      }
+    }
+    for (int i = x_count(empty), c = static_cast<int>(filled.size()) - 1; i >= 1; i--) {
+      while (choose(c, i) > x_rank) {
+        c--;
+      }
+      board[filled[c]] = Mark::X;
+      x_rank -= choose(c, i);
+    }
+    return board;
+  }
+
+ private:
+  uint64_t choose(int n, int k) const {
+    return k > n ? 0 : binomial[n][k];
+  }
+  array<array<uint64_t, board_size + 1>, board_size + 1> binomial = {};
+};
+
+// Exact values for every position with at most max_empty empty cells, two
+// bits per position. Only symmetry-canonical positions are solved; the
+// others are probed through their canonical form.
+template<int N, int D>
+class Tablebase {
+ public:
+  constexpr static Position board_size = BoardData<N, D>::board_size;
+  constexpr static uint32_t magic = 0x42545454;
+  using Board = typename TablebaseIndex<N, D>::Board;
+
+  struct Header {
+    uint32_t magic;
+    uint32_t n, d, max_empty;
+    uint64_t bytes;
+  };
+
+  explicit Tablebase(const BoardData<N, D>& data)
+      : data(data), symmetries(data.symmetries()) {
+  }
+
+  Tablebase(const Tablebase&) = delete;
+
+  ~Tablebase() {
+    if (mapped != nullptr) {
+      unmap();
+    }
+  }
+
+  int max_empty() const {
+    return empty_limit;
+  }
+
+  uint64_t size() const {
+    return layer_offset.empty() ? 0 : layer_offset.back();
+  }
+
+  // Retrograde analysis: each layer only depends on the layer with one
+  // empty cell less, so the positions inside a layer are solved in parallel.
+  void build(int max_empty) {
+    empty_limit = max_empty;
+    compute_offsets();
+    owned.assign((size() + 3) / 4 + 1, 0xFF);
+    table = owned.data();
+    for (int empty = 0; empty <= max_empty; empty++) {
+      uint64_t layer = index.layer_size(empty);
+      vector<uint64_t> blocks;
+      for (uint64_t start = 0; start < layer; start += block_size) {
+        blocks.push_back(start);
+      }
+      for_each(execution::par, begin(blocks), end(blocks), [&](uint64_t start) {
+        uint64_t last = min(layer, start + block_size);
+        for (uint64_t rank = start; rank < last; rank++) {
+          solve(rank, empty);
+        }
+      });
+    }
+  }
+
+  // Positions above the table are turned away before the board is copied.
+  optional<BoardValue> probe(const State<N, D>& state) const {
+    int empty = state.get_empty_count();
+    if (empty > empty_limit) {
+      return {};
+    }
+    Board board;
+    for (Position pos = 0_pos; pos < board_size; ++pos) {
+      board[pos] = state.get_board(pos);
+    }
+    return get_value(canonical_rank(board, empty), empty);
+  }
+
+  void save(string filename) const {
+    ofstream ofs(filename, ios::binary);
+    Header header{magic, N, D, static_cast<uint32_t>(empty_limit), (size() + 3) / 4 + 1};
+    ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char *>(table), header.bytes);
+  }
+
+  // The file is only accepted when its header matches this board and the
+  // table it announces fits in the file.
+  bool load(string filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(Header)) {
+      close(fd);
+      return false;
+    }
+    mapped_size = info.st_size;
+    mapped = mmap(nullptr, mapped_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+      mapped = nullptr;
+      return false;
+    }
+    const Header *header = static_cast<const Header *>(mapped);
+    if (header->magic != magic || header->n != N || header->d != D
+        || header->max_empty > static_cast<uint32_t>(board_size)
+        || header->bytes > mapped_size - sizeof(Header)) {
+      unmap();
+      return false;
+    }
+    empty_limit = header->max_empty;
+    compute_offsets();
+    if (header->bytes != (size() + 3) / 4 + 1) {
+      empty_limit = -1;
+      layer_offset.clear();
+      unmap();
+      return false;
+    }
+    table = static_cast<const uint8_t *>(mapped) + sizeof(Header);
+    return true;
+  }
+
+ private:
+  constexpr static uint64_t block_size = 4096;
+  const BoardData<N, D>& data;
+  const vector<vector<Position>> symmetries;
+  TablebaseIndex<N, D> index;
+  vector<uint64_t> layer_offset;
+  vector<uint8_t> owned;
+  const uint8_t *table = nullptr;
+  void *mapped = nullptr;
+  size_t mapped_size = 0;
+  int empty_limit = -1;
+
+  void unmap() {
+    munmap(mapped, mapped_size);
+    mapped = nullptr;
+    mapped_size = 0;
+  }
+
+  void compute_offsets() {
+    layer_offset.assign(1, 0);
+    for (int empty = 0; empty <= empty_limit; empty++) {
+      // Layers start on a byte boundary so parallel blocks never share a byte.
+      layer_offset.push_back((layer_offset.back() + index.layer_size(empty) + 3) / 4 * 4);
+    }
+  }
+
+  BoardValue get_value(uint64_t rank, int empty) const {
+    uint64_t offset = layer_offset[empty] + rank;
+    return static_cast<BoardValue>((table[offset / 4] >> (2 * (offset % 4))) & 3);
+  }
+
+  void set_value(uint64_t rank, int empty, BoardValue value) {
+    uint64_t offset = layer_offset[empty] + rank;
+    uint8_t& cell = owned[offset / 4];
+    cell &= ~(3 << (2 * (offset % 4)));
+    cell |= static_cast<uint8_t>(value) << (2 * (offset % 4));
+  }
+
+  uint64_t canonical_rank(const Board& board, int empty) const {
+    uint64_t best = numeric_limits<uint64_t>::max();
+    for (const auto& symmetry : symmetries) {
+      best = min(best, index.rank(transform_board(board, symmetry), empty));
+    }
+    return best;
+  }
+
+  bool is_canonical(const Board& board, uint64_t rank, int empty) const {
+    return all_of(begin(symmetries), end(symmetries), [&](const auto& symmetry) {
+      return index.rank(transform_board(board, symmetry), empty) >= rank;
+    });
+  }
+
+  Board transform_board(const Board& board, const vector<Position>& symmetry) const {
+    Board transformed;
+    for (Position pos = 0_pos; pos < board_size; ++pos) {
+      transformed[symmetry[pos]] = board[pos];
+    }
+    return transformed;
+  }
+
+  optional<BoardValue> winner(const Board& board) const {
+    for (const auto& line : data.winning_lines()) {
+      Mark first = board[line[0_side]];
+      if (first != Mark::empty && all_of(begin(line), end(line), [&](Position pos) {
+            return board[pos] == first;
+          })) {
+        return first == Mark::X ? BoardValue::X_WIN : BoardValue::O_WIN;
+      }
+    }
+    return {};
+  }
+
+  void solve(uint64_t rank, int empty) {
+    Board board = index.unrank(rank, empty);
+    if (!is_canonical(board, rank, empty)) {
+      return;
+    }
+    if (auto win = winner(board); win.has_value()) {
+      set_value(rank, empty, *win);
+      return;
+    }
+    if (empty == 0) {
+      set_value(rank, empty, BoardValue::DRAW);
+      return;
+    }
+    Turn turn = TablebaseIndex<N, D>::turn(empty);
+    optional<BoardValue> best;
+    for (Position pos = 0_pos; pos < board_size; ++pos) {
+      if (board[pos] != Mark::empty) {
+        continue;
+      }
+      board[pos] = to_mark(turn);
+      BoardValue child = get_value(canonical_rank(board, empty - 1), empty - 1);
+      board[pos] = Mark::empty;
+      if (!best.has_value()) {
+        best = child;
+      } else {
+        best = turn == Turn::X ? min(*best, child) : max(*best, child);
+      }
+    }
+    set_value(rank, empty, *best);
+  }
+};
+
+#endif
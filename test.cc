@@ -1,5 +1,7 @@
 #include "minimax.hh"
+#include "pn2.hh"
 #include "node.hh"
+#include "alphabeta.hh"
 #include "gtest/gtest.h"
 
 namespace {
@@ -639,10 +641,45 @@ TEST(MiniMaxTest, Check33DFS) {
   EXPECT_TRUE(minimax.get_solution().validate());
 }
 
+TEST(MiniMaxTest, Check32ParallelDFS) {
+  BoardData<3, 2> data;
+  State state(data);
+  auto minimax = MiniMax<3, 2, ParallelDFS<3, 2, DefaultConfig::max_created>>(state, data);
+  minimax.traversal.set_threads(4);
+  auto result = minimax.play(state, Turn::X);
+  EXPECT_EQ(BoardValue::DRAW, *result);
+  EXPECT_TRUE(minimax.get_solution().validate());
+}
+
+TEST(MiniMaxTest, Check42ParallelDFSMatchesDFS) {
+  BoardData<4, 2> data;
+  State state(data);
+  auto serial = make_unique<MiniMax<4, 2>>(state, data);
+  EXPECT_EQ(BoardValue::DRAW, *serial->play(state, Turn::X));
+  auto parallel = make_unique<MiniMax<4, 2, ParallelDFS<4, 2, DefaultConfig::max_created>>>(state, data);
+  parallel->traversal.set_threads(4);
+  EXPECT_EQ(BoardValue::DRAW, *parallel->play(state, Turn::X));
+  EXPECT_TRUE(parallel->get_solution().validate());
+  EXPECT_GT(parallel->nodes_visited, 1000);
+  EXPECT_EQ(parallel->nodes_created, static_cast<int>(parallel->get_solution().size()));
+}
+
+// Without the chaining strategy 3^3 is no longer solved at the root, so the
+// searches below have a tree to build.
+struct ConfigNoChaining {
+  constexpr static NodeCount max_visited = DefaultConfig::max_visited;
+  constexpr static NodeCount max_created = DefaultConfig::max_created;
+  constexpr static bool should_chain = false;
+  DummyCout debug;
+  bool should_log_evolution = false;
+  bool should_prune = true;
+  size_t transposition_bytes = 16 << 20;
+};
+
 TEST(MiniMaxTest, Check32PNSearch) {
   BoardData<3, 2> data;
   State state(data);
-  auto minimax = MiniMax<3, 2, PNSearch<3, 2, MiniMax<3, 2>::M>>(state, data);
+  auto minimax = MiniMax<3, 2, PNSearch<3, 2, DefaultConfig::max_created>>(state, data);
   auto result = minimax.play(state, Turn::X);
   EXPECT_EQ(BoardValue::DRAW, *result);
   EXPECT_TRUE(minimax.get_solution().validate());
@@ -651,18 +688,454 @@ TEST(MiniMaxTest, Check32PNSearch) {
 TEST(MiniMaxTest, Check33PNSearch) {
   BoardData<3, 3> data;
   State state(data);
-  auto minimax = MiniMax<3, 3, PNSearch<3, 3, MiniMax<3, 2>::M>>(state, data);
+  auto minimax = MiniMax<3, 3, PNSearch<3, 3, ConfigNoChaining::max_created>, ConfigNoChaining>(state, data);
+  auto result = minimax.play(state, Turn::X);
+  EXPECT_EQ(BoardValue::X_WIN, *result);
+  EXPECT_EQ(205, minimax.nodes_visited);
+  EXPECT_TRUE(minimax.get_solution().validate());
+}
+
+TEST(MiniMaxTest, Check32ParallelPNSearch) {
+  BoardData<3, 2> data;
+  State state(data);
+  auto minimax = MiniMax<3, 2, ParallelPNSearch<3, 2, DefaultConfig::max_created>>(state, data);
+  minimax.traversal.set_threads(4);
+  auto result = minimax.play(state, Turn::X);
+  EXPECT_EQ(BoardValue::DRAW, *result);
+  EXPECT_TRUE(minimax.get_solution().validate());
+}
+
+TEST(MiniMaxTest, Check33ParallelPNSearch) {
+  BoardData<3, 3> data;
+  State state(data);
+  using Search = ParallelPNSearch<3, 3, ConfigNoChaining::max_created>;
+  auto minimax = MiniMax<3, 3, Search, ConfigNoChaining>(state, data);
+  minimax.traversal.set_threads(4);
+  auto result = minimax.play(state, Turn::X);
+  EXPECT_EQ(BoardValue::X_WIN, *result);
+  // The batches change with the thread timing, the count only roughly.
+  EXPECT_GT(minimax.nodes_visited, 100);
+  EXPECT_TRUE(minimax.get_solution().validate());
+}
+
+TEST(MiniMaxTest, Check32DFPNSearch) {
+  BoardData<3, 2> data;
+  State state(data);
+  auto minimax = MiniMax<3, 2, DFPNSearch<3, 2, DefaultConfig::max_created>>(state, data);
+  auto result = minimax.play(state, Turn::X);
+  EXPECT_EQ(BoardValue::DRAW, *result);
+  EXPECT_TRUE(minimax.get_solution().validate());
+}
+
+TEST(MiniMaxTest, Check33DFPNSearch) {
+  BoardData<3, 3> data;
+  State state(data);
+  auto minimax = MiniMax<3, 3, DFPNSearch<3, 3, ConfigNoChaining::max_created>, ConfigNoChaining>(state, data);
   auto result = minimax.play(state, Turn::X);
   EXPECT_EQ(BoardValue::X_WIN, *result);
+  EXPECT_EQ(203, minimax.nodes_visited);
+  EXPECT_TRUE(minimax.get_solution().validate());
+}
+
+TEST(MiniMaxTest, Check32PN2Search) {
+  BoardData<3, 2> data;
+  State state(data);
+  auto minimax = MiniMax<3, 2, PN2Search<3, 2, DefaultConfig::max_created, 64>>(state, data);
+  auto result = minimax.play(state, Turn::X);
+  EXPECT_EQ(BoardValue::DRAW, *result);
+  EXPECT_TRUE(minimax.get_solution().validate());
+}
+
+TEST(MiniMaxTest, Check33PN2Search) {
+  BoardData<3, 3> data;
+  State state(data);
+  using Search = PN2Search<3, 3, ConfigNoChaining::max_created, 64>;
+  auto minimax = MiniMax<3, 3, Search, ConfigNoChaining>(state, data);
+  auto result = minimax.play(state, Turn::X);
+  EXPECT_EQ(BoardValue::X_WIN, *result);
+  EXPECT_EQ(142, minimax.nodes_visited);
+  EXPECT_TRUE(minimax.get_solution().validate());
+}
+
+TEST(MiniMaxTest, ResetRepeatsTheSearch) {
+  BoardData<3, 3> data;
+  State state(data);
+  auto minimax = make_unique<MiniMax<3, 3, DFPNSearch<3, 3, MiniMax<3, 3>::M>>>(state, data);
+  EXPECT_EQ(BoardValue::X_WIN, *minimax->play(state, Turn::X));
+  auto visited = minimax->nodes_visited;
+  auto created = minimax->nodes_created;
+  minimax->reset();
+  EXPECT_FALSE(minimax->get_solution().get_root()->is_final());
+  EXPECT_EQ(BoardValue::X_WIN, *minimax->play(state, Turn::X));
+  EXPECT_EQ(visited, minimax->nodes_visited);
+  EXPECT_EQ(created, minimax->nodes_created);
+  EXPECT_TRUE(minimax->get_solution().validate());
+}
+
+TEST(MiniMaxTest, Check32PNSearchWithGarbageCollection) {
+  BoardData<3, 2> data;
+  State state(data);
+  auto minimax = MiniMax<3, 2, PNSearch<3, 2, DefaultConfig::max_created>>(state, data);
+  minimax.set_garbage_collection(64);
+  auto result = minimax.play(state, Turn::X);
+  EXPECT_EQ(BoardValue::DRAW, *result);
+  EXPECT_LT(minimax.get_solution().size(), minimax.nodes_created);
+  EXPECT_TRUE(minimax.get_solution().validate());
+}
+
+TEST(MiniMaxTest, Check32DFPNSearchWithGarbageCollection) {
+  BoardData<3, 2> data;
+  State state(data);
+  auto minimax = MiniMax<3, 2, DFPNSearch<3, 2, DefaultConfig::max_created>>(state, data);
+  minimax.set_garbage_collection(64);
+  auto result = minimax.play(state, Turn::X);
+  EXPECT_EQ(BoardValue::DRAW, *result);
+  EXPECT_LT(minimax.get_solution().size(), minimax.nodes_created);
+  EXPECT_TRUE(minimax.get_solution().validate());
+}
+
+struct ConfigLiveLines {
+  constexpr static NodeCount max_visited = 1'000'000_nc;
+  constexpr static NodeCount max_created = 1'000'000_nc;
+  DummyCout debug;
+  bool should_log_evolution = false;
+  bool should_prune = true;
+  size_t transposition_bytes = 1 << 20;
+  using ProofInit = LiveLineInit;
+};
+
+TEST(MiniMaxTest, Check32PNSearchWithLiveLineInit) {
+  BoardData<3, 2> data;
+  State state(data);
+  auto minimax = MiniMax<3, 2, PNSearch<3, 2, ConfigLiveLines::max_created>, ConfigLiveLines>(state, data);
+  auto result = minimax.play(state, Turn::X);
+  EXPECT_EQ(BoardValue::DRAW, *result);
+  EXPECT_TRUE(minimax.get_solution().validate());
+}
+
+template<typename Search>
+void expect_fewer_visits_with_deduplication() {
+  BoardData<3, 2> data;
+  State state(data);
+  auto plain = make_unique<MiniMax<3, 2, Search>>(state, data);
+  EXPECT_EQ(BoardValue::DRAW, *plain->play(state, Turn::X));
+  auto shared = make_unique<MiniMax<3, 2, Search>>(state, data);
+  shared->set_deduplicate(true);
+  EXPECT_EQ(BoardValue::DRAW, *shared->play(state, Turn::X));
+  EXPECT_TRUE(shared->get_solution().validate());
+  EXPECT_LT(shared->nodes_visited, plain->nodes_visited);
+  EXPECT_LT(shared->nodes_created, plain->nodes_created);
+}
+
+TEST(MiniMaxTest, Check32PNSearchWithDeduplication) {
+  expect_fewer_visits_with_deduplication<PNSearch<3, 2, DefaultConfig::max_created>>();
+}
+
+TEST(MiniMaxTest, Check32DFPNSearchWithDeduplication) {
+  expect_fewer_visits_with_deduplication<DFPNSearch<3, 2, DefaultConfig::max_created>>();
+}
+
+TEST(MiniMaxTest, DFPNSearchSkipsSolvedChildOnSaturatedTie) {
+  BoardData<3, 2> data;
+  State state(data);
+  constexpr NodeCount M = DefaultConfig::max_created;
+  SolutionTree<M> solution(BoardData<3, 2>::board_size);
+  auto root = solution.get_root();
+  DFPNSearch<3, 2, M> search(data, root);
+  DefaultConfig config;
+  int nodes_created = 1;
+  search.push_node(BoardNode<3, 2, M>{state, Turn::X, root});
+  EXPECT_EQ(root, search.pop_best(solution, nodes_created, config).node);
+  search.pop_best(solution, nodes_created, config);
+  ASSERT_GT(root->get_position_count(), 1);
+  // Every child saturated at infinity, and the first one already disproved.
+  for (int i = 0; i < root->get_position_count(); i++) {
+    auto child = root->get_child(i);
+    child->set_is_eval(true);
+    child->set_proof(Node<M>::INFTY);
+  }
+  auto disproved = root->get_child(0);
+  disproved->set_value(BoardValue::DRAW);
+  disproved->set_disproof(0_pn);
+  disproved->set_is_final(true);
+  search.relocate();
+  auto leaf = search.pop_best(solution, nodes_created, config);
+  EXPECT_NE(disproved, leaf.node->get_parent());
+  EXPECT_EQ(root, leaf.node->get_parent()->get_parent());
+}
+
+TEST(MiniMaxTest, Check32DFPNSearchWithEpsilon) {
+  BoardData<3, 2> data;
+  State state(data);
+  auto minimax = MiniMax<3, 2, DFPNSearch<3, 2, ConfigLiveLines::max_created>, ConfigLiveLines>(state, data);
+  minimax.traversal.set_epsilon(0.25);
+  auto result = minimax.play(state, Turn::X);
+  EXPECT_EQ(BoardValue::DRAW, *result);
   EXPECT_TRUE(minimax.get_solution().validate());
 }
 
+TEST(MoveOrderingTest, RewardedMovesBreakTies) {
+  BoardData<3, 2> data;
+  State state(data);
+  MoveOrdering<3, 2> ordering(data);
+  auto corner = data.encode({0_side, 0_side});
+  auto other = data.encode({2_side, 2_side});
+  EXPECT_EQ(ordering.score(state, Turn::X, 1, corner, 3_lcount), ordering.score(state, Turn::X, 1, other, 3_lcount));
+  ordering.reward(Turn::X, 1, other);
+  EXPECT_LT(ordering.score(state, Turn::X, 1, corner, 3_lcount), ordering.score(state, Turn::X, 1, other, 3_lcount));
+  EXPECT_GT(ordering.score(state, Turn::X, 1, corner, 4_lcount), ordering.score(state, Turn::X, 1, other, 3_lcount));
+  ordering.set_heuristics(0);
+  EXPECT_EQ(ordering.score(state, Turn::X, 1, corner, 3_lcount), ordering.score(state, Turn::X, 1, other, 3_lcount));
+}
+
+TEST(BoardNodeTest, LiveLineInitCountsLinesOfX) {
+  BoardData<3, 2> data;
+  State state(data);
+  EXPECT_EQ(make_pair(1_pn, 8_pn), LiveLineInit::initial(state, Turn::X, 9));
+  state.play({1_side, 1_side}, Mark::O);
+  EXPECT_EQ(make_pair(1_pn, 4_pn), LiveLineInit::initial(state, Turn::X, 8));
+  EXPECT_EQ(make_pair(8_pn, 2_pn), LiveLineInit::initial(state, Turn::O, 8));
+}
+
+struct ConfigMetrics {
+  constexpr static NodeCount max_visited = DefaultConfig::max_visited;
+  constexpr static NodeCount max_created = DefaultConfig::max_created;
+  DummyCout debug;
+  bool should_log_evolution = false;
+  bool should_prune = false;
+  size_t transposition_bytes = 16 << 20;
+  using Metrics = SearchMetrics;
+};
+
+TEST(MiniMaxTest, Check33PNSearchWithMetrics) {
+  BoardData<3, 3> data;
+  State state(data);
+  auto minimax = MiniMax<3, 3, PNSearch<3, 3, ConfigMetrics::max_created>, ConfigMetrics>(state, data);
+  EXPECT_EQ(BoardValue::X_WIN, *minimax.play(state, Turn::X));
+  auto metrics = minimax.get_metrics();
+  EXPECT_EQ(static_cast<uint64_t>(minimax.nodes_visited), metrics.nodes_visited);
+  EXPECT_EQ(static_cast<uint64_t>(minimax.running_final),
+            accumulate(begin(metrics.reasons), end(metrics.reasons), 0ull) -
+            metrics.reasons[static_cast<int>(Reason::PRUNING)]);
+  EXPECT_EQ(1u, metrics.expansions[1]);
+  EXPECT_GT(metrics.branching[1], 1.0);
+  EXPECT_GT(metrics.chaining_searches, 0u);
+  EXPECT_GT(metrics.max_depth, 0);
+  ostringstream json;
+  minimax.write_metrics(json, MetricsFormat::JSON);
+  EXPECT_NE(string::npos, json.str().find("\"CHAINING\": "));
+  ostringstream prometheus;
+  minimax.write_metrics(prometheus, MetricsFormat::PROMETHEUS);
+  EXPECT_NE(string::npos, prometheus.str().find("tictactoe_expansions{depth=\"1\"} 1\n"));
+}
+
+TEST(MiniMaxTest, Check33MemoryAccount) {
+  BoardData<3, 3> data;
+  State state(data);
+  auto minimax = MiniMax<3, 3, PNSearch<3, 3, ConfigMetrics::max_created>, ConfigMetrics>(state, data);
+  EXPECT_EQ(BoardValue::X_WIN, *minimax.play(state, Turn::X));
+  const auto& memory = minimax.get_memory();
+  EXPECT_EQ(minimax.get_solution().memory_bytes(),
+            memory.get(MemoryPart::NODES).live + memory.get(MemoryPart::CHILDREN).live);
+  EXPECT_GT(memory.get(MemoryPart::CHILDREN).live, 0u);
+  EXPECT_EQ(16u << 20, memory.get(MemoryPart::TRANSPOSITION).live);
+  EXPECT_EQ(data.memory_bytes(), memory.get(MemoryPart::BOARD_DATA).live);
+  EXPECT_GT(memory.get(MemoryPart::CHAINING).peak, 0u);
+  for (int i = 0; i < memory_part_count; i++) {
+    const auto& usage = memory.get(static_cast<MemoryPart>(i));
+    EXPECT_GE(usage.peak, usage.live);
+  }
+  EXPECT_GE(memory.total_peak(), memory.total_live());
+  EXPECT_EQ(0u, memory.summary().find("memory "));
+}
+
+TEST(PhaseTimersTest, NestedPhasesAreExclusive) {
+  PhaseTimers::reset();
+  {
+    ScopedTimer<true> outer(Phase::SELECT);
+    for (int i = 0; i < 3; i++) {
+      ScopedTimer<true> inner(Phase::EMBRYOS);
+      ScopedTimer<false> disabled(Phase::CREATE);
+    }
+  }
+  auto totals = PhaseTimers::collect();
+  EXPECT_EQ(1u, totals[static_cast<int>(Phase::SELECT)].calls);
+  EXPECT_EQ(3u, totals[static_cast<int>(Phase::EMBRYOS)].calls);
+  EXPECT_EQ(0u, totals[static_cast<int>(Phase::CREATE)].calls);
+  ostringstream report;
+  PhaseTimers::report(report);
+  EXPECT_NE(string::npos, report.str().find("embryos\t"));
+}
+
+TEST(RingBufferTest, PushUntilFull) {
+  RingBuffer<int, 4> buffer;
+  for (int i = 0; i < 4; i++) {
+    EXPECT_TRUE(buffer.push(i));
+  }
+  EXPECT_FALSE(buffer.push(4));
+  array<int, 8> out;
+  EXPECT_EQ(3u, buffer.pop(out.data(), 3));
+  EXPECT_EQ(2, out[2]);
+  EXPECT_TRUE(buffer.push(4));
+  EXPECT_EQ(2u, buffer.pop(out.data(), out.size()));
+  EXPECT_EQ(4, out[1]);
+  EXPECT_EQ(0u, buffer.pop(out.data(), out.size()));
+}
+
+TEST(EvolutionTraceTest, SampledRecordsReachTheFile) {
+  string filename = "evolution_test.bin";
+  {
+    EvolutionTrace trace;
+    trace.set_sampling(2);
+    trace.open(filename);
+    for (uint32_t i = 1; i <= 10; i++) {
+      trace.log(EvolutionRecord{i, 1, 2, 3, 4, 5});
+    }
+  }
+  ifstream ifs(filename, ios::binary);
+  array<uint32_t, 3> header;
+  ifs.read(reinterpret_cast<char *>(header.data()), sizeof(header));
+  EXPECT_EQ(EvolutionTrace::magic, header[0]);
+  EXPECT_EQ(sizeof(EvolutionRecord), header[2]);
+  vector<EvolutionRecord> records(6);
+  ifs.read(reinterpret_cast<char *>(records.data()), records.size() * sizeof(EvolutionRecord));
+  EXPECT_EQ(5 * sizeof(EvolutionRecord), static_cast<size_t>(ifs.gcount()));
+  EXPECT_EQ(2u, records[0].visited);
+  EXPECT_EQ(10u, records[4].visited);
+  remove(filename.c_str());
+}
+
+struct ConfigCheckpoint {
+  constexpr static NodeCount max_visited = 4_nc;
+  constexpr static NodeCount max_created = DefaultConfig::max_created;
+  DummyCout debug;
+  bool should_log_evolution = false;
+  bool should_prune = false;
+  size_t transposition_bytes = 16 << 20;
+};
+
+TEST(MiniMaxTest, ResumeFromCheckpoint) {
+  BoardData<3, 3> data;
+  State state(data);
+  string filename = testing::TempDir() + "checkpoint.bin";
+  using Search = PNSearch<3, 3, DefaultConfig::max_created>;
+  auto partial = make_unique<MiniMax<3, 3, Search, ConfigCheckpoint>>(state, data);
+  partial->play(state, Turn::X);
+  EXPECT_FALSE(partial->get_solution().get_root()->is_final());
+  partial->write_checkpoint(filename);
+  auto resumed = make_unique<MiniMax<3, 3, Search>>(state, data);
+  ASSERT_TRUE(resumed->resume(filename));
+  EXPECT_EQ(partial->nodes_created, resumed->nodes_created);
+  auto result = resumed->play(state, Turn::X);
+  EXPECT_EQ(BoardValue::X_WIN, *result);
+  EXPECT_TRUE(resumed->get_solution().validate());
+}
+
+TEST(MiniMaxTest, TruncatedCheckpointLeavesSearchIntact) {
+  BoardData<3, 3> data;
+  State state(data);
+  string filename = testing::TempDir() + "complete.bin";
+  string truncated = testing::TempDir() + "truncated.bin";
+  using Search = PNSearch<3, 3, DefaultConfig::max_created>;
+  auto partial = make_unique<MiniMax<3, 3, Search, ConfigCheckpoint>>(state, data);
+  partial->play(state, Turn::X);
+  ASSERT_TRUE(partial->write_checkpoint(filename));
+  {
+    ifstream ifs(filename, ios::binary);
+    string contents((istreambuf_iterator<char>(ifs)), istreambuf_iterator<char>());
+    ofstream ofs(truncated, ios::binary);
+    ofs.write(contents.data(), contents.size() / 2);
+  }
+  auto resumed = make_unique<MiniMax<3, 3, Search>>(state, data);
+  ASSERT_TRUE(resumed->resume(filename));
+  uint32_t size = resumed->get_solution().size();
+  EXPECT_FALSE(resumed->resume(truncated));
+  EXPECT_EQ(size, resumed->get_solution().size());
+  EXPECT_EQ(partial->nodes_created, resumed->nodes_created);
+  EXPECT_EQ(BoardValue::X_WIN, *resumed->play(state, Turn::X));
+  EXPECT_TRUE(resumed->get_solution().validate());
+  remove(truncated.c_str());
+}
+
+TEST(MiniMaxTest, FailedCheckpointKeepsNoFile) {
+  BoardData<3, 3> data;
+  State state(data);
+  string filename = testing::TempDir() + "missing/checkpoint.bin";
+  using Search = PNSearch<3, 3, DefaultConfig::max_created>;
+  auto partial = make_unique<MiniMax<3, 3, Search, ConfigCheckpoint>>(state, data);
+  partial->play(state, Turn::X);
+  EXPECT_FALSE(partial->write_checkpoint(filename));
+  EXPECT_FALSE(ifstream(filename + ".tmp").good());
+}
+
+TEST(MiniMaxTest, PeriodicCheckpointDuringPlay) {
+  BoardData<3, 3> data;
+  State state(data);
+  string filename = testing::TempDir() + "periodic.bin";
+  remove(filename.c_str());
+  using Search = PNSearch<3, 3, DefaultConfig::max_created>;
+  auto partial = make_unique<MiniMax<3, 3, Search, ConfigCheckpoint>>(state, data);
+  partial->set_checkpoint(filename, 1);
+  partial->play(state, Turn::X);
+  auto resumed = make_unique<MiniMax<3, 3, Search>>(state, data);
+  ASSERT_TRUE(resumed->resume(filename));
+  EXPECT_GT(resumed->nodes_visited, 0);
+  EXPECT_LE(resumed->nodes_visited, partial->nodes_visited);
+  EXPECT_EQ(BoardValue::X_WIN, *resumed->play(state, Turn::X));
+}
+
+// Sends SIGINT to the process at the first debug output once armed.
+struct InterruptingCout {
+  inline static bool armed = false;
+  template<typename T>
+  const InterruptingCout& operator<<(const T& x) const {
+    if (armed) {
+      armed = false;
+      raise(SIGINT);
+    }
+    return *this;
+  }
+};
+
+struct ConfigInterrupt {
+  constexpr static NodeCount max_visited = DefaultConfig::max_visited;
+  constexpr static NodeCount max_created = DefaultConfig::max_created;
+  InterruptingCout debug;
+  bool should_log_evolution = false;
+  bool should_prune = false;
+  size_t transposition_bytes = 16 << 20;
+};
+
+TEST(MiniMaxTest, InterruptSavesCheckpoint) {
+  BoardData<3, 3> data;
+  State state(data);
+  string filename = testing::TempDir() + "interrupt.bin";
+  remove(filename.c_str());
+  using Search = PNSearch<3, 3, DefaultConfig::max_created>;
+  using Interrupted = MiniMax<3, 3, Search, ConfigInterrupt>;
+  auto outer_handler = signal(SIGINT, SIG_IGN);
+  auto partial = make_unique<Interrupted>(state, data);
+  partial->set_checkpoint(filename, 1'000'000);
+  InterruptingCout::armed = true;
+  partial->play(state, Turn::X);
+  EXPECT_FALSE(partial->get_solution().get_root()->is_final());
+  EXPECT_EQ(SIG_IGN, signal(SIGINT, outer_handler));
+  // A later search in the same process is not stopped by the old signal.
+  auto fresh = make_unique<Interrupted>(state, data);
+  EXPECT_EQ(BoardValue::X_WIN, *fresh->play(state, Turn::X));
+  auto resumed = make_unique<MiniMax<3, 3, Search>>(state, data);
+  ASSERT_TRUE(resumed->resume(filename));
+  EXPECT_EQ(partial->nodes_visited, resumed->nodes_visited);
+  EXPECT_EQ(BoardValue::X_WIN, *resumed->play(state, Turn::X));
+}
+
 struct ConfigBFSOne {
   constexpr static NodeCount max_visited = 1_nc;
   constexpr static NodeCount max_created = 100_nc;
   DummyCout debug;
   bool should_log_evolution = false;
   bool should_prune = false;
+  size_t transposition_bytes = 1 << 20;
 };
 
 TEST(MiniMaxTest, CheckOneNodeOfBFS) {
@@ -683,6 +1156,7 @@ struct ConfigBFSMax {
   DummyCout debug;
   bool should_log_evolution = false;
   bool should_prune = false;
+  size_t transposition_bytes = 1 << 20;
 };
 
 /*TEST(MiniMaxTest, CheckMaxCreated) {
@@ -704,6 +1178,239 @@ struct ConfigBFSMax {
   solution.dump(data, "/dev/null");
 }*/
 
+TEST(TablebaseTest, RankUnrankRoundTrip) {
+  TablebaseIndex<4, 2> index;
+  for (int empty = 0; empty <= 16; empty++) {
+    uint64_t layer = index.layer_size(empty);
+    for (uint64_t rank = 0; rank < layer; rank += 1 + layer / 97) {
+      EXPECT_EQ(rank, index.rank(index.unrank(rank, empty), empty));
+    }
+  }
+}
+
+TEST(TablebaseTest, Solve32) {
+  BoardData<3, 2> data;
+  Tablebase<3, 2> tablebase(data);
+  tablebase.build(9);
+  State state(data);
+  EXPECT_EQ(BoardValue::DRAW, *tablebase.probe(state));
+  state.play({1_side, 1_side}, Mark::X);
+  state.play({0_side, 1_side}, Mark::O);
+  EXPECT_EQ(7, state.get_empty_count());
+  EXPECT_EQ(BoardValue::X_WIN, *tablebase.probe(state));
+}
+
+TEST(TablebaseTest, ProbeAboveTheLimit) {
+  BoardData<3, 2> data;
+  Tablebase<3, 2> tablebase(data);
+  tablebase.build(7);
+  State state(data);
+  EXPECT_FALSE(tablebase.probe(state).has_value());
+  state.play({1_side, 1_side}, Mark::X);
+  EXPECT_FALSE(tablebase.probe(state).has_value());
+  state.play({0_side, 1_side}, Mark::O);
+  EXPECT_EQ(BoardValue::X_WIN, *tablebase.probe(state));
+}
+
+TEST(TablebaseTest, LoadRejectsDamagedFiles) {
+  BoardData<3, 2> data;
+  Tablebase<3, 2> tablebase(data);
+  tablebase.build(7);
+  string filename = testing::TempDir() + "tablebase.bin";
+  string truncated = filename + ".truncated";
+  tablebase.save(filename);
+  {
+    ifstream ifs(filename, ios::binary);
+    string contents((istreambuf_iterator<char>(ifs)), istreambuf_iterator<char>());
+    ofstream ofs(truncated, ios::binary);
+    ofs.write(contents.data(), contents.size() - 1);
+  }
+  Tablebase<3, 2> loaded(data);
+  EXPECT_TRUE(loaded.load(filename));
+  EXPECT_EQ(7, loaded.max_empty());
+  Tablebase<3, 2> damaged(data);
+  EXPECT_FALSE(damaged.load(truncated));
+  EXPECT_EQ(-1, damaged.max_empty());
+  BoardData<3, 3> other_data;
+  Tablebase<3, 3> other(other_data);
+  EXPECT_FALSE(other.load(filename));
+  remove(filename.c_str());
+  remove(truncated.c_str());
+}
+
+TEST(MiniMaxTest, Check32DFSWithTablebase) {
+  BoardData<3, 2> data;
+  Tablebase<3, 2> tablebase(data);
+  tablebase.build(5);
+  State state(data);
+  auto minimax = MiniMax(state, data);
+  minimax.set_tablebase(tablebase);
+  auto result = minimax.play(state, Turn::X);
+  EXPECT_EQ(BoardValue::DRAW, *result);
+  EXPECT_TRUE(minimax.get_solution().validate());
+}
+
+TEST(TranspositionTableTest, StoreAndFind) {
+  TranspositionTable table(1 << 12);
+  table.store({0x1234'5678'9abc'def0ull, 42}, 7, 3);
+  EXPECT_EQ(7u, *table.find({0x1234'5678'9abc'def0ull, 42}));
+  EXPECT_FALSE(table.find({0x1234'5678'9abc'def0ull, 43}).has_value());
+  EXPECT_FALSE(table.find({0x4321'5678'9abc'def0ull, 42}).has_value());
+  auto stats = table.stats();
+  EXPECT_EQ(1u, stats.hits);
+  EXPECT_EQ(2u, stats.misses);
+  EXPECT_EQ(1u, stats.collisions);
+}
+
+TEST(TranspositionTableTest, ReplaceLowestPriority) {
+  TranspositionTable table(64);
+  EXPECT_EQ(4u, table.capacity());
+  for (uint32_t i = 0; i < 4; i++) {
+    table.store({static_cast<Zobrist>(i) << 32, i}, i, static_cast<uint16_t>(10 + i));
+  }
+  table.store({5ull << 32, 5}, 5, 1);
+  EXPECT_FALSE(table.find({0, 0}).has_value());
+  EXPECT_EQ(3u, *table.find({3ull << 32, 3}));
+  EXPECT_EQ(5u, *table.find({5ull << 32, 5}));
+  EXPECT_EQ(1u, table.stats().replacements);
+}
+
+TEST(TranspositionTableTest, StoreUpdatesKeyBehindEmptySlot) {
+  TranspositionTable table(64);
+  table.store({1ull << 32, 1}, 1, 10);
+  table.store({2ull << 32, 2}, 2, 10);
+  // Drops the first entry, leaving an empty slot before the second.
+  table.relocate([](uint32_t value) -> optional<uint32_t> {
+    return value == 1 ? optional<uint32_t>{} : value;
+  });
+  table.store({2ull << 32, 2}, 20, 10);
+  int entries = 0;
+  table.relocate([&](uint32_t value) -> optional<uint32_t> {
+    entries++;
+    return value;
+  });
+  EXPECT_EQ(1, entries);
+  EXPECT_EQ(20u, *table.find({2ull << 32, 2}));
+}
+
+TEST(AlphaBetaTest, Solve32And33) {
+  BoardData<3, 2> data32;
+  AlphaBeta<3, 2> alphabeta32(data32, 1 << 16);
+  EXPECT_EQ(BoardValue::DRAW, alphabeta32.solve(State(data32), Turn::X));
+  EXPECT_EQ(9, alphabeta32.get_depth());
+  BoardData<3, 3> data33;
+  AlphaBeta<3, 3> alphabeta33(data33, 1 << 16);
+  EXPECT_EQ(BoardValue::X_WIN, alphabeta33.solve(State(data33), Turn::X));
+}
+
+// Walks every reply of the other side, on every live cell, and checks that
+// the strategy always has a legal move and never lets the other side win.
+template<int N, int D>
+bool check_strategy(const ProvingStrategy& strategy, const State<N, D>& state, Turn turn,
+    Turn prover, BoardValue value, set<pair<Zobrist, Signature>>& seen) {
+  if (!seen.insert({state.get_zobrist(), state.get_signature()}).second) {
+    return true;
+  }
+  if (state.get_open_positions(to_mark(turn)).none()) {
+    return value == BoardValue::DRAW;
+  }
+  if (turn == prover) {
+    auto it = strategy.find({state.get_zobrist(), state.get_signature()});
+    if (it == strategy.end() || !state.get_live_cells().check(it->second)) {
+      return false;
+    }
+    State<N, D> child = state;
+    return child.play(it->second, to_mark(turn)) ||
+        check_strategy(strategy, child, flip(turn), prover, value, seen);
+  }
+  for (Position pos : state.get_live_cells()) {
+    State<N, D> child = state;
+    if (child.play(pos, to_mark(turn)) || !check_strategy(strategy, child, flip(turn), prover, value, seen)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template<int N, int D>
+bool check_strategy(const ProvingStrategy& strategy, const State<N, D>& state,
+    Turn turn, Turn prover, BoardValue value) {
+  set<pair<Zobrist, Signature>> seen;
+  return check_strategy(strategy, state, turn, prover, value, seen);
+}
+
+TEST(AlphaBetaTest, ExtractStrategy) {
+  BoardData<3, 2> data32;
+  AlphaBeta<3, 2> alphabeta32(data32, 1 << 16);
+  auto draw = alphabeta32.extract_strategy(State(data32), Turn::X);
+  ASSERT_TRUE(draw.has_value());
+  EXPECT_TRUE(check_strategy(*draw, State(data32), Turn::X, Turn::O, BoardValue::DRAW));
+  BoardData<3, 3> data33;
+  AlphaBeta<3, 3> alphabeta33(data33, 1 << 16);
+  auto win = alphabeta33.extract_strategy(State(data33), Turn::X);
+  ASSERT_TRUE(win.has_value());
+  EXPECT_TRUE(check_strategy(*win, State(data33), Turn::X, Turn::X, BoardValue::X_WIN));
+}
+
+TEST(AlphaBetaTest, ParallelMatchesSerial) {
+  BoardData<3, 3> data33;
+  AlphaBeta<3, 3> alphabeta33(data33, 1 << 16);
+  alphabeta33.set_threads(4);
+  auto win = alphabeta33.extract_strategy(State(data33), Turn::X);
+  ASSERT_TRUE(win.has_value());
+  EXPECT_TRUE(check_strategy(*win, State(data33), Turn::X, Turn::X, BoardValue::X_WIN));
+  BoardData<4, 2> data42;
+  AlphaBeta<4, 2> alphabeta42(data42, 1 << 20);
+  alphabeta42.set_threads(4);
+  EXPECT_EQ(BoardValue::DRAW, alphabeta42.solve(State(data42), Turn::X));
+}
+
+TEST(ChunkedArenaTest, StableAddressesAndHandles) {
+  ChunkedArena<array<uint64_t, 8>> arena(100'000);
+  vector<array<uint64_t, 8>*> elements;
+  for (uint64_t i = 0; i < 100'000; i++) {
+    elements.push_back(arena.emplace_back());
+    elements.back()->fill(i);
+  }
+  EXPECT_TRUE(arena.is_full());
+  EXPECT_GT(arena.memory_bytes(), 100'000 * sizeof(array<uint64_t, 8>));
+  for (uint32_t i = 0; i < 100'000; i += 997) {
+    EXPECT_EQ(i, (*elements[i])[7]);
+    EXPECT_EQ(i, decltype(arena)::handle_of(elements[i]));
+    EXPECT_EQ(&arena, decltype(arena)::arena_of(elements[i]));
+    EXPECT_EQ(elements[i], &arena[i]);
+  }
+}
+
+TEST(NodeArenaTest, ChildArraysCountTowardTheBudget) {
+  NodeArena<1000> arena(10);
+  for (int i = 0; i < 5; i++) {
+    arena.emplace_back(nullptr, Turn::X, 0);
+  }
+  EXPECT_FALSE(arena.is_full());
+  arena.slabs.allocate(5 * sizeof(Node<1000>) / sizeof(uint32_t));
+  EXPECT_TRUE(arena.is_full());
+}
+
+struct ConfigSmallBudget {
+  constexpr static NodeCount max_visited = 1'000'000_nc;
+  constexpr static NodeCount max_created = 16_nc;
+  DummyCout debug;
+  bool should_log_evolution = false;
+  bool should_prune = true;
+  size_t transposition_bytes = 1 << 20;
+};
+
+TEST(MiniMaxTest, Check33PNSearchWithRuntimeBudget) {
+  BoardData<3, 3> data;
+  State state(data);
+  auto minimax = MiniMax<3, 3, PNSearch<3, 3, ConfigSmallBudget::max_created>, ConfigSmallBudget>(state, data);
+  minimax.set_node_budget(1'000'000);
+  auto result = minimax.play(state, Turn::X);
+  EXPECT_EQ(BoardValue::X_WIN, *result);
+  EXPECT_TRUE(minimax.get_solution().validate());
+}
+
 template<int M, typename MM>
 bool validate_all_parents(const Node<M> *parent, MM& minimax) {
   if (!parent->has_children()) {
@@ -714,7 +1421,8 @@ bool validate_all_parents(const Node<M> *parent, MM& minimax) {
     const auto child_node = child_pair.second;
     if (child_node->get_parent() != parent) {
       auto child_state = child_node->rebuild_state(minimax.data);
-      if (child_node != minimax.zobrist[child_state.get_zobrist()]) {
+      TranspositionKey key{child_state.get_zobrist(), child_state.get_signature()};
+      if (child_node != minimax.find_transposition(key)) {
         return false;
       }
     }
@@ -733,6 +1441,45 @@ TEST(SolutionTreeTest, ValidateParents) {
   EXPECT_TRUE(validate_all_parents<decltype(minimax)::M>(root, minimax));
 }
 
+TEST(SolutionTreeTest, ChildrenViewFiltersChildren) {
+  BoardData<3, 3> data;
+  State state(data);
+  auto minimax = MiniMax<3, 3, PNSearch<3, 3, ConfigSmallBudget::max_created>, ConfigSmallBudget>(state, data);
+  minimax.play(state, Turn::X);
+  auto root = minimax.get_solution().get_root();
+  vector<pair<Position, Node<ConfigSmallBudget::max_created>*>> expected;
+  for (int i = 0; i < root->get_position_count(); i++) {
+    auto child = root->get_child(i);
+    if (child == nullptr || child->get_reason() == Reason::PRUNING) {
+      continue;
+    }
+    expected.emplace_back(root->get_position_at(i), child->get_zobrist_first());
+  }
+  auto children = root->get_children();
+  EXPECT_EQ(expected.size(), children.size());
+  EXPECT_TRUE(equal(begin(children), end(children), begin(expected), end(expected)));
+}
+
+TEST(SolutionTreeTest, CachedPathMatchesWalk) {
+  BoardData<3, 3> data;
+  State state(data);
+  auto minimax = MiniMax<3, 3, PNSearch<3, 3, ConfigSmallBudget::max_created>, ConfigSmallBudget>(state, data);
+  minimax.play(state, Turn::X);
+  auto& solution = minimax.get_solution();
+  for (uint32_t i = 0; i < solution.size(); i++) {
+    auto node = solution.at(i);
+    int depth = 1;
+    bool ancestor_final = false;
+    for (auto p = node; p->has_parent(); p = p->get_parent()) {
+      depth++;
+      ancestor_final |= p->get_parent()->is_final();
+    }
+    EXPECT_EQ(depth, node->get_depth());
+    EXPECT_EQ(depth % 2 == 1 ? Turn::X : Turn::O, node->get_turn());
+    EXPECT_EQ(ancestor_final, node->some_parent_final());
+  }
+}
+
 TEST(SolutionDagTest, CreateSolutionDag) {
   BoardData<3, 2> data;
   State state(data);
@@ -0,0 +1,183 @@
+#ifndef TIMERS_HH
+#define TIMERS_HH
+
+#include <array>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "boarddata.hh"
+
+enum class Phase {
+  SELECT,
+  REBUILD,
+  WIN,
+  ZOBRIST,
+  TABLEBASE,
+  DRAW,
+  CHAINING,
+  FORCED_WIN,
+  EMBRYOS,
+  CREATE,
+  RETIRE,
+  BACKUP
+};
+
+constexpr int phase_count = static_cast<int>(Phase::BACKUP) + 1;
+
+inline const char *phase_name(Phase phase) {
+  constexpr array<const char *, phase_count> names{
+    "select", "rebuild_state", "win", "zobrist", "tablebase", "draw", "chaining",
+    "forced_win", "embryos", "create", "retire", "backup"
+  };
+  return names[static_cast<int>(phase)];
+}
+
+// The time stamp counter where there is one, else the steady clock.
+inline uint64_t read_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// Ticks and calls per phase. Each thread adds to a table of its own, and
+// the tables are summed for the breakdown. A thread that ends folds its
+// table into the retired totals.
+class PhaseTimers {
+ public:
+  struct Totals {
+    uint64_t ticks, calls;
+  };
+  using Table = array<Totals, phase_count>;
+
+  static Table& local() {
+    thread_local Local table;
+    return table.totals;
+  }
+
+  static Table collect() {
+    lock_guard guard(registry_mutex);
+    Table sum = retired;
+    for (auto table : tables) {
+      add(sum, table->totals);
+    }
+    return sum;
+  }
+
+  static void reset() {
+    lock_guard guard(registry_mutex);
+    retired = Table{};
+    for (auto table : tables) {
+      table->totals = Table{};
+    }
+    origin = {chrono::steady_clock::now(), read_ticks()};
+  }
+
+  // Phases are exclusive: a phase nested in another is only counted once.
+  static void report(ostream& os) {
+    auto sum = collect();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - origin.first;
+    double ticks_per_second = (read_ticks() - origin.second) / max(elapsed.count(), 1e-9);
+    uint64_t total = 0;
+    for (const auto& totals : sum) {
+      total += totals.ticks;
+    }
+    os << "phase\t\ttime(ms)\tshare\tcalls\tticks/call\n";
+    for (int i = 0; i < phase_count; i++) {
+      const auto& totals = sum[i];
+      string name = phase_name(static_cast<Phase>(i));
+      os << name << (name.size() < 8 ? "\t\t" : "\t") << fixed << setprecision(3)
+         << 1000.0 * totals.ticks / ticks_per_second << "\t" << setprecision(1)
+         << (total > 0 ? 100.0 * totals.ticks / total : 0.0) << "%\t" << totals.calls << "\t"
+         << setprecision(0) << (totals.calls > 0 ? static_cast<double>(totals.ticks) / totals.calls : 0.0)
+         << "\n";
+    }
+    os << defaultfloat << setprecision(6);
+  }
+
+ private:
+  struct Local {
+    Table totals{};
+    Local() {
+      lock_guard guard(registry_mutex);
+      tables.push_back(this);
+    }
+    ~Local() {
+      lock_guard guard(registry_mutex);
+      add(retired, totals);
+      tables.erase(find(begin(tables), end(tables), this));
+    }
+  };
+
+  static void add(Table& sum, const Table& table) {
+    for (int i = 0; i < phase_count; i++) {
+      sum[i].ticks += table[i].ticks;
+      sum[i].calls += table[i].calls;
+    }
+  }
+
+  inline static mutex registry_mutex;
+  inline static vector<Local *> tables;
+  inline static Table retired{};
+  inline static pair<chrono::steady_clock::time_point, uint64_t> origin{
+      chrono::steady_clock::now(), read_ticks()};
+};
+
+// Adds the time until the end of the scope to a phase, minus the time of
+// the timers nested in it. Disabled timers are empty.
+template<bool enabled>
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(Phase phase) {
+  }
+};
+
+template<>
+class ScopedTimer<true> {
+ public:
+  explicit ScopedTimer(Phase phase) : phase(phase), parent(current), start(read_ticks()) {
+    current = this;
+  }
+  ~ScopedTimer() {
+    uint64_t elapsed = read_ticks() - start;
+    auto& totals = PhaseTimers::local()[static_cast<int>(phase)];
+    totals.ticks += elapsed - nested;
+    totals.calls++;
+    if (parent != nullptr) {
+      parent->nested += elapsed;
+    }
+    current = parent;
+  }
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+ private:
+  Phase phase;
+  ScopedTimer *parent;
+  uint64_t start;
+  uint64_t nested = 0;
+  inline static thread_local ScopedTimer *current = nullptr;
+};
+
+// The timers are turned on by the config with
+// `constexpr static bool should_time_phases = true;`.
+template<typename Config>
+struct TimersOf {
+  constexpr static bool enabled = false;
+};
+
+template<typename Config>
+  requires requires { Config::should_time_phases; }
+struct TimersOf<Config> {
+  constexpr static bool enabled = Config::should_time_phases;
+};
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef TRACE_HH
+#define TRACE_HH
+
+#include <array>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <vector>
+#include "boarddata.hh"
+
+// Bounded queue for exactly one producer and one consumer. Each side only
+// writes its own index, so a push and a pop never wait on each other.
+template<typename T, size_t capacity>
+class RingBuffer {
+  static_assert((capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+ public:
+  bool push(const T& value) {
+    auto head = this->head.load(memory_order_relaxed);
+    if (head - tail.load(memory_order_acquire) == capacity) {
+      return false;
+    }
+    items[head & (capacity - 1)] = value;
+    this->head.store(head + 1, memory_order_release);
+    return true;
+  }
+
+  // Pops up to size items into out, returning how many.
+  size_t pop(T *out, size_t size) {
+    auto tail = this->tail.load(memory_order_relaxed);
+    auto available = min<size_t>(head.load(memory_order_acquire) - tail, size);
+    for (size_t i = 0; i < available; i++) {
+      out[i] = items[(tail + i) & (capacity - 1)];
+    }
+    this->tail.store(tail + available, memory_order_release);
+    return available;
+  }
+
+ private:
+  array<T, capacity> items;
+  alignas(64) atomic<size_t> head = 0;
+  alignas(64) atomic<size_t> tail = 0;
+};
+
+// One sampled step of a proof-number search.
+struct EvolutionRecord {
+  uint32_t visited;
+  uint32_t proof, disproof;
+  uint32_t depth;
+  uint32_t running_zobrist, running_final;
+};
+static_assert(sizeof(EvolutionRecord) == 24);
+
+// Binary trace of the search, read by pnevolution.py. The search only
+// copies a record into a ring buffer, and a background thread writes the
+// buffer to the file. When the writer falls behind the search waits, so no
+// record is lost. Only one record in every `sampling` is kept.
+class EvolutionTrace {
+ public:
+  constexpr static uint32_t magic = 0x56454e50;
+  constexpr static uint32_t version = 1;
+
+  EvolutionTrace() = default;
+  EvolutionTrace(const EvolutionTrace&) = delete;
+  EvolutionTrace& operator=(const EvolutionTrace&) = delete;
+  EvolutionTrace(EvolutionTrace&&) = delete;
+  EvolutionTrace& operator=(EvolutionTrace&&) = delete;
+
+  ~EvolutionTrace() {
+    close();
+  }
+
+  // Records are dropped if the file cannot be created.
+  void open(string filename) {
+    close();
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (file == nullptr) {
+      return;
+    }
+    array<uint32_t, 3> header{magic, version, sizeof(EvolutionRecord)};
+    fwrite(header.data(), sizeof(uint32_t), header.size(), file);
+    shared = make_unique<Shared>();
+    writer = thread([this, file] {
+      drain(file);
+    });
+  }
+
+  void set_sampling(int every) {
+    sampling = max(every, 1);
+  }
+
+  void log(const EvolutionRecord& record) {
+    if (shared == nullptr || ++skipped < sampling) {
+      return;
+    }
+    skipped = 0;
+    while (!shared->buffer.push(record)) {
+      this_thread::yield();
+    }
+  }
+
+  void close() {
+    if (shared == nullptr) {
+      return;
+    }
+    shared->done.store(true, memory_order_release);
+    writer.join();
+    shared.reset();
+  }
+
+ private:
+  constexpr static size_t capacity = 1 << 16;
+  constexpr static size_t block = 4096;
+
+  struct Shared {
+    RingBuffer<EvolutionRecord, capacity> buffer;
+    atomic<bool> done = false;
+  };
+
+  // Runs in the writer thread until the search closes the trace.
+  void drain(FILE *file) {
+    vector<EvolutionRecord> records(block);
+    while (true) {
+      bool stopping = shared->done.load(memory_order_acquire);
+      auto size = shared->buffer.pop(records.data(), block);
+      fwrite(records.data(), sizeof(EvolutionRecord), size, file);
+      if (size == 0) {
+        if (stopping) {
+          break;
+        }
+        this_thread::sleep_for(chrono::milliseconds(1));
+      }
+    }
+    fclose(file);
+  }
+
+  unique_ptr<Shared> shared;
+  thread writer;
+  int sampling = 1;
+  int skipped = 0;
+};
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef TRANSPOSITION_HH
+#define TRANSPOSITION_HH
+
+#include <atomic>
+#include <iostream>
+#include <array>
+#include <vector>
+#include <optional>
+#include <bit>
+#include "boarddata.hh"
+
+struct TranspositionKey {
+  Zobrist zobrist;
+  Signature signature;
+};
+
+// Preallocated, open-addressed table with one cache line per bucket. The low
+// bits of the zobrist select the bucket, and each entry is verified against
+// the high bits of the zobrist plus an independent board signature. Entries
+// use lockless hashing (key stored xor data), so a torn write between threads
+// reads as a miss instead of a wrong hit.
+class TranspositionTable {
+ public:
+  constexpr static int bucket_entries = 4;
+
+  struct Stats {
+    uint64_t hits, misses, collisions, stores, replacements;
+  };
+
+  explicit TranspositionTable(size_t bytes)
+      : buckets(bit_floor(max(bytes / sizeof(Bucket), size_t{1}))),
+        mask(buckets.size() - 1) {
+  }
+
+  optional<uint32_t> find(TranspositionKey key) {
+    auto& bucket = buckets[key.zobrist & mask];
+    uint64_t packed = pack_key(key);
+    for (auto& entry : bucket.entries) {
+      uint64_t data = entry.data.load(memory_order_relaxed);
+      uint64_t stored = entry.key.load(memory_order_relaxed) ^ data;
+      if ((data & valid_bit) == 0) {
+        continue;
+      }
+      if (stored == packed) {
+        hits.fetch_add(1, memory_order_relaxed);
+        return static_cast<uint32_t>(data);
+      }
+      if ((stored >> 32) == (packed >> 32)) {
+        collisions.fetch_add(1, memory_order_relaxed);
+      }
+    }
+    misses.fetch_add(1, memory_order_relaxed);
+    return {};
+  }
+
+  // Overwrites the entry with the same key if present, else fills an empty
+  // slot, else evicts the entry with the lowest priority in the bucket. The
+  // whole bucket is searched for the key first, so a key never holds two
+  // entries. An evicted value is only lost to later probes: MiniMax keeps
+  // solved nodes, so a transposition that misses is solved again and
+  // becomes the head of a new zobrist chain, while the old chain keeps
+  // linking to its own head, which stays in the tree with the same value.
+  void store(TranspositionKey key, uint32_t value, uint16_t priority) {
+    auto& bucket = buckets[key.zobrist & mask];
+    uint64_t packed = pack_key(key);
+    Entry *victim = nullptr;
+    Entry *empty = nullptr;
+    Entry *lowest = &bucket.entries[0];
+    uint64_t lowest_priority = numeric_limits<uint64_t>::max();
+    for (auto& entry : bucket.entries) {
+      uint64_t data = entry.data.load(memory_order_relaxed);
+      if ((data & valid_bit) == 0) {
+        if (empty == nullptr) {
+          empty = &entry;
+        }
+        continue;
+      }
+      if ((entry.key.load(memory_order_relaxed) ^ data) == packed) {
+        victim = &entry;
+        break;
+      }
+      uint64_t entry_priority = (data >> 32) & 0xFFFF;
+      if (entry_priority < lowest_priority) {
+        lowest = &entry;
+        lowest_priority = entry_priority;
+      }
+    }
+    if (victim == nullptr) {
+      victim = empty;
+    }
+    if (victim == nullptr) {
+      victim = lowest;
+      replacements.fetch_add(1, memory_order_relaxed);
+    }
+    uint64_t data = valid_bit | (static_cast<uint64_t>(priority) << 32) | value;
+    victim->data.store(data, memory_order_relaxed);
+    victim->key.store(packed ^ data, memory_order_relaxed);
+    stores.fetch_add(1, memory_order_relaxed);
+  }
+
+  void clear() {
+    for (auto& bucket : buckets) {
+      for (auto& entry : bucket.entries) {
+        entry.key.store(0, memory_order_relaxed);
+        entry.data.store(0, memory_order_relaxed);
+      }
+    }
+  }
+
+  size_t capacity() const {
+    return buckets.size() * bucket_entries;
+  }
+
+  size_t memory_bytes() const {
+    return buckets.size() * sizeof(Bucket);
+  }
+
+  void save(ostream& os) const {
+    uint64_t size = buckets.size();
+    os.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    for (const auto& bucket : buckets) {
+      for (const auto& entry : bucket.entries) {
+        array<uint64_t, 2> words{entry.key.load(), entry.data.load()};
+        os.write(reinterpret_cast<const char *>(words.data()), sizeof(words));
+      }
+    }
+  }
+
+  // Reads through a saved table without changing this one.
+  bool check(istream& is) const {
+    uint64_t size = 0;
+    is.read(reinterpret_cast<char *>(&size), sizeof(size));
+    if (!is || size != buckets.size()) {
+      return false;
+    }
+    auto bytes = static_cast<streamsize>(size * sizeof(Bucket::entries));
+    is.ignore(bytes);
+    return is.gcount() == bytes;
+  }
+
+  // Fails when the checkpoint was taken with a table of another size.
+  bool load(istream& is) {
+    uint64_t size = 0;
+    is.read(reinterpret_cast<char *>(&size), sizeof(size));
+    if (!is || size != buckets.size()) {
+      return false;
+    }
+    for (auto& bucket : buckets) {
+      for (auto& entry : bucket.entries) {
+        array<uint64_t, 2> words;
+        is.read(reinterpret_cast<char *>(words.data()), sizeof(words));
+        entry.key.store(words[0]);
+        entry.data.store(words[1]);
+      }
+    }
+    return static_cast<bool>(is);
+  }
+
+  // Rewrites the stored values after the nodes they point to were moved,
+  // dropping the entries whose node is gone.
+  template<typename F>
+  void relocate(F forward) {
+    for (auto& bucket : buckets) {
+      for (auto& entry : bucket.entries) {
+        uint64_t data = entry.data.load(memory_order_relaxed);
+        if ((data & valid_bit) == 0) {
+          continue;
+        }
+        uint64_t packed = entry.key.load(memory_order_relaxed) ^ data;
+        optional<uint32_t> value = forward(static_cast<uint32_t>(data));
+        uint64_t moved = value.has_value() ? (data & 0xFFFFFFFF00000000ull) | *value : 0;
+        entry.data.store(moved, memory_order_relaxed);
+        entry.key.store(value.has_value() ? packed ^ moved : 0, memory_order_relaxed);
+      }
+    }
+  }
+
+  Stats stats() const {
+    return Stats{hits.load(), misses.load(), collisions.load(), stores.load(), replacements.load()};
+  }
+
+ private:
+  constexpr static uint64_t valid_bit = 1ull << 63;
+
+  struct Entry {
+    atomic<uint64_t> key;
+    atomic<uint64_t> data;
+  };
+
+  struct alignas(64) Bucket {
+    array<Entry, bucket_entries> entries;
+  };
+
+  static uint64_t pack_key(TranspositionKey key) {
+    return (key.zobrist & 0xFFFFFFFF00000000ull) | key.signature;
+  }
+
+  vector<Bucket> buckets;
+  uint64_t mask;
+  atomic<uint64_t> hits = 0, misses = 0, collisions = 0, stores = 0, replacements = 0;
+};
+
+#endif
@@ -18,18 +18,22 @@
 #include <stack>
 #include <mutex>
 #include <numeric>
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
 #include "semantic.hh"
 #include "boarddata.hh"
 #include "state.hh"
 #include "solutiontree.hh"
 #include "strategies.hh"
+#include "ordering.hh"
 
 template<int N, int D, int M>
 class DFS {
   int step = 0;
  public:
-  explicit DFS(const BoardData<N, D>& data, Node<M> *root) : data(data), root(root) {
+  explicit DFS(const BoardData<N, D>& data, Node<M> *root) : ordering(data), data(data), root(root) {
   }
+  MoveOrdering<N, D> ordering;
   void push_node(BoardNode<N, D, M> node) {
     next.push(node);
   }
@@ -38,9 +42,11 @@ class DFS {
     ChildrenBuilder<N, D, Config> builder;
     auto embryos = builder.get_embryos(board_node);
     auto children = builder.build_children(solution, nodes_created, embryos);
-    vector<pair<LineCount, BoardNode<N, D, M>*>> pointers;
+    auto& [state, turn, node] = board_node;
+    vector<pair<typename MoveOrdering<N, D>::Score, BoardNode<N, D, M>*>> pointers;
     for (int i = 0; i < static_cast<int>(children.size()); i++) {
-      pointers.emplace_back(embryos[i].accumulation_point, &children[i]);
+      auto score = ordering.score(state, turn, node->get_depth(), embryos[i].pos, embryos[i].accumulation_point);
+      pointers.emplace_back(score, &children[i]);
     }
     sort(begin(pointers), end(pointers), [](const auto& a, const auto& b) {
       return a.first < b.first;
@@ -64,18 +70,61 @@ class DFS {
   bool empty() const {
     return next.empty();
   }
-  void retire(const BoardNode<N, D, M>& node, bool is_terminal) {
-    // empty
+  // Rewards every move that settled its parent early, up the cascade the
+  // terminal node started.
+  void retire(const BoardNode<N, D, M>& board_node, bool is_terminal) {
+    if (!is_terminal) {
+      return;
+    }
+    for (auto node = board_node.node; node->has_parent(); node = node->get_parent()) {
+      auto parent = node->get_parent();
+      if (!parent->is_final() || parent->get_reason() != Reason::MINIMAX_EARLY ||
+          parent->get_value() != node->get_value()) {
+        break;
+      }
+      ordering.reward(parent->get_turn(), parent->get_depth(), node->get_position());
+    }
   }
   float estimate_work(const Node<M> *node) {
     return node->estimate_work();
   }
+  // Bytes held by the nodes waiting to be visited.
+  size_t frontier_bytes() const {
+    return next.size() * sizeof(BoardNode<N, D, M>);
+  }
  private:
   stack<BoardNode<N, D, M>> next;
   const BoardData<N, D>& data;
   Node<M> *root;
 };
 
+// Depth-first search split over threads Young Brothers Wait style. MiniMax
+// runs it as tasks instead of popping nodes from the stack: the first child
+// of a node is searched alone, and the other children are spawned as tasks
+// only when it does not settle the node. A child that settles the node
+// cancels the siblings still running. The move ordering is only read, so
+// it keeps the history of earlier searches but learns nothing new.
+template<int N, int D, int M>
+class ParallelDFS : public DFS<N, D, M> {
+  int threads = 1;
+ public:
+  explicit ParallelDFS(const BoardData<N, D>& data, Node<M> *root) : DFS<N, D, M>(data, root) {
+  }
+  void set_threads(int count) {
+    threads = count;
+  }
+  template<typename F>
+  void run_tasks(F func) {
+    tbb::task_arena arena(threads);
+    arena.execute(func);
+  }
+};
+
+template<typename T>
+concept TaskTraversal = requires (T traversal) {
+  traversal.run_tasks([]() {});
+};
+
 template<int N, int D, int M>
 class BFS {
  public:
@@ -97,7 +146,7 @@ class BFS {
   BoardNode<N, D, M> pop_best(SolutionTree<M>& solution, int& nodes_created, Config& config) {
     auto node = next.front();
     next.pop();
-    return BoardNode<N, D, M>{node->rebuild_state(data), node->get_turn(), node};
+    return BoardNode<N, D, M>{rebuild_state<Config>(node), node->get_turn(), node};
   }
   bool empty() const {
     return next.empty();
@@ -108,21 +157,43 @@ class BFS {
   float estimate_work(const Node<M> *node) {
     return node->estimate_work();
   }
+  size_t frontier_bytes() const {
+    return next.size() * sizeof(Node<M>*);
+  }
  private:
   queue<Node<M>*> next;
   const BoardData<N, D>& data;
   Node<M> *root;
+
+  template<typename Config>
+  State<N, D> rebuild_state(const Node<M> *node) const {
+    ScopedTimer<TimersOf<Config>::enabled> timer(Phase::REBUILD);
+    return node->rebuild_state(data);
+  }
 };
 
 template<int N, int D, int M>
 class PNSearch {
+ protected:
   optional<Node<M>*> descent;
   int step = 0;
+  NodeWorklist<M> dirty;
+  bool deduplicate = false;
+  bag<pair<Node<M>*, ProofNumber>> sources;
   const BoardData<N, D>& data;
   Node<M> *root;
  public:
   explicit PNSearch(const BoardData<N, D>& data, Node<M> *root) : data(data), root(root) {
   }
+  // Source node detection in the sums, for trees that share unsolved
+  // transpositions. MiniMax::set_deduplicate turns on both.
+  void set_deduplicate(bool value) {
+    deduplicate = value;
+  }
+  // The tree is the frontier, so only the worklist of the backup counts.
+  size_t frontier_bytes() const {
+    return dirty.memory_bytes();
+  }
   void push_node(BoardNode<N, D, M> board_node) {
   }
   template<typename S, typename Config>
@@ -153,10 +224,10 @@ class PNSearch {
         assert(false);
       }
       if (node->has_parent()) {
-        update_pn_value(node->get_parent(), flip(board_node.turn));
+        update_pn_value(node->get_parent());
       }
     } else {
-      update_pn_value(node, board_node.turn);
+      update_pn_value(node);
     }
     /*if (step < 100) {
       ostringstream oss;
@@ -168,13 +239,28 @@ class PNSearch {
   float estimate_work(const Node<M> *node) {
     return node->estimate_work();
   }
- private:
+  // The search always starts from the root, which never moves.
+  void relocate() {
+  }
+  // Forgets the search before the tree is cleared for a new one.
+  void reset() {
+    descent.reset();
+  }
+ protected:
+  template<typename Config>
+  State<N, D> rebuild_state(const Node<M> *node) const {
+    ScopedTimer<TimersOf<Config>::enabled> timer(Phase::REBUILD);
+    return node->rebuild_state(data);
+  }
+
   template<typename Config>
   BoardNode<N, D, M> choose_best_pn_node(SolutionTree<M>& solution, int& nodes_created, Config& config) {
-    return search_any_node(root, solution, nodes_created, config, true);
+    return search_any_node(root, rebuild_state<Config>(root), solution, nodes_created, config, true);
   }
 
-  void update_work(Node<M>* node) {
+  // Returns whether the work changed.
+  bool update_work(Node<M>* node) {
+    auto old_work = node->work;
     if (node->is_final() || !node->has_children()) {
       node->work = 1.0f;
     } else {
@@ -184,44 +270,127 @@ class PNSearch {
         return a + b.second->work;
       }) / size;
     }
+    return node->work != old_work;
   }
 
-  void update_pn_value(Node<M> *node, Turn turn) {
-    update_work(node);
+  // Recomputes the proof numbers and work of a node from its children.
+  // Returns whether any of them changed.
+  bool update_node(Node<M> *node) {
+    bool changed = update_work(node);
     if (node->has_children()) {
       auto children = node->get_children();
       if (!children.empty()) {
-        if (turn == Turn::O) {
-          auto proof = accumulate(begin(children), end(children), 0_pn, [](const auto& a, const auto& b) {
-            return ProofNumber{a + b.second->get_proof()};
+        auto old_proof = node->get_proof();
+        auto old_disproof = node->get_disproof();
+        if (node->get_turn() == Turn::O) {
+          auto proof = sum_children(children, Turn::X, [](const auto& child) {
+            return child->get_proof();
           });
           node->set_proof(clamp(proof, 0_pn, Node<M>::INFTY));
           node->set_disproof(min_disproof(node, children)->get_disproof());
         } else {
-          auto disproof = accumulate(begin(children), end(children), 0_pn, [](const auto& a, const auto& b) {
-            return ProofNumber{a + b.second->get_disproof()};
+          auto disproof = sum_children(children, Turn::O, [](const auto& child) {
+            return child->get_disproof();
           });
           node->set_disproof(clamp(disproof, 0_pn, Node<M>::INFTY));
           node->set_proof(min_proof(node, children)->get_proof());
         }
+        changed |= node->get_proof() != old_proof || node->get_disproof() != old_disproof;
       }
     }
-    if (node->has_parent()) {
-      for (auto sibling = node->get_zobrist_first(); sibling != nullptr; sibling = sibling->get_zobrist_next()) {
-        update_pn_value(sibling->get_parent(), flip(turn));
+    return changed;
+  }
+
+  // Children whose numbers come from the same shared node are counted once,
+  // by their largest value, since solving that node settles all of them.
+  template<typename C, typename T>
+  ProofNumber sum_children(const C& children, Turn min_turn, const T& pluck) {
+    if (!deduplicate) {
+      return accumulate(begin(children), end(children), 0_pn, [&](const auto& a, const auto& b) {
+        return ProofNumber{a + pluck(b.second)};
+      });
+    }
+    sources.clear();
+    for (const auto& [pos, child] : children) {
+      sources.emplace_back(source(child, min_turn, pluck), pluck(child));
+    }
+    sort(begin(sources), end(sources));
+    ProofNumber total = 0_pn;
+    for (int i = 0; i < static_cast<int>(sources.size()); i++) {
+      bool repeated = sources[i].first != nullptr && i + 1 < static_cast<int>(sources.size()) &&
+          sources[i + 1].first == sources[i].first;
+      if (!repeated) {
+        total = ProofNumber{total + sources[i].second};
+      }
+    }
+    return total;
+  }
+
+  // The shared node the numbers of a node are taken from. The walk follows
+  // the best child while the node takes the minimum of its children, and
+  // the only child that counts while the node sums them. Shared nodes are
+  // the heads of zobrist chains with other nodes in them.
+  template<typename T>
+  Node<M> *source(Node<M> *node, Turn min_turn, const T& pluck) {
+    while (true) {
+      if (node->get_zobrist_next() != nullptr) {
+        return node;
+      }
+      if (node->is_final() || !node->has_children()) {
+        return nullptr;
+      }
+      auto children = node->get_children();
+      if (children.empty()) {
+        return nullptr;
+      }
+      if (node->get_turn() == min_turn) {
+        node = min_element(begin(children), end(children), [&](const auto& a, const auto& b) {
+          return pluck(a.second) < pluck(b.second);
+        })->second;
+        continue;
+      }
+      Node<M> *single = nullptr;
+      for (const auto& [pos, child] : children) {
+        if (pluck(child) == 0_pn) {
+          continue;
+        }
+        if (single != nullptr) {
+          return nullptr;
+        }
+        single = child;
+      }
+      if (single == nullptr) {
+        return nullptr;
       }
+      node = single;
     }
   }
 
+  // Backs up the numbers from a node to the root. Every dirty node is
+  // recomputed once, and the walk stops at nodes that do not change. The
+  // first node always passes the update on, since its children may have
+  // changed without changing it back, as when virtual numbers are restored.
+  void update_pn_value(Node<M> *node) {
+    dirty.push(node);
+    while (!dirty.empty()) {
+      auto current = dirty.pop();
+      if (update_node(current) || current == node) {
+        dirty.push_parents(current);
+      }
+    }
+  }
+
+  // The state of each node is taken from the embryo chosen in its parent,
+  // so the descent never replays the game from the root.
   template<typename Config>
   BoardNode<N, D, M> search_any_node(
-      Node<M>* node, SolutionTree<M>& solution, int& nodes_created, Config& config, bool or_node) {
+      Node<M>* node, const State<N, D>& state, SolutionTree<M>& solution, int& nodes_created,
+      Config& config, bool or_node) {
+    auto board_node = BoardNode<N, D, M>{state, node->get_turn(), node};
     if (!node->is_eval()) {
-      auto board_node = BoardNode<N, D, M>{node->rebuild_state(data), node->get_turn(), node};
       node->set_is_eval(true);
       return board_node;
     }
-    auto board_node = BoardNode<N, D, M>{node->rebuild_state(data), node->get_turn(), node};
     ChildrenBuilder<N, D, Config> builder;
     auto embryos = builder.get_embryos(board_node);
     if (!node->has_children()) {
@@ -237,14 +406,20 @@ class PNSearch {
         min_embryo(embryos, get_proof) :
         min_embryo(embryos, get_disproof);
     // return parent_state.get_current_accumulation(a.first) > parent_state.get_current_accumulation(b.first);*/
-    return search_any_node(*selected_embryo.self, solution, nodes_created, config, !or_node);
+    return search_any_node(selected_embryo.child(), selected_embryo.state, solution, nodes_created, config,
+                           !or_node);
   }
 
+  // Solved children are only picked when nothing else is left, since
+  // saturated sums may tie them with unsolved ones.
   template<typename T>
   auto min_embryo(bag<Embryo<N, D, M>>& embryos, T pluck) {
     assert(!embryos.empty());
+    auto is_final = [](const auto& embryo) {
+      return embryo.child() != nullptr && embryo.child()->is_final();
+    };
     return *min_element(begin(embryos), end(embryos), [&](const auto &a, const auto &b) {
-      return pluck(a) < pluck(b);
+      return make_pair(is_final(a), pluck(a)) < make_pair(is_final(b), pluck(b));
     });
   }
 
@@ -277,4 +452,236 @@ class PNSearch {
   }
 };
 
+template<typename T>
+concept BatchTraversal = requires (T traversal) {
+  { traversal.get_threads() } -> same_as<int>;
+};
+
+// Parallel proof-number search. A batch of distinct most-proving leaves is
+// selected with virtual proof numbers: each selected leaf temporarily gets
+// infinite proof and disproof numbers, so the next descent steers away from
+// it. The leaves are then evaluated concurrently, and their real numbers are
+// restored and backed up sequentially when MiniMax commits the batch.
+template<int N, int D, int M>
+class ParallelPNSearch : public PNSearch<N, D, M> {
+  using Base = PNSearch<N, D, M>;
+  constexpr static int leaves_per_thread = 2;
+  int threads = 1;
+  // The numbers of the leaves in the current batch, hidden by the virtual
+  // ones until the batch is committed.
+  bag<pair<Node<M>*, pair<ProofNumber, ProofNumber>>> real_numbers;
+ public:
+  explicit ParallelPNSearch(const BoardData<N, D>& data, Node<M> *root) : Base(data, root) {
+  }
+  void set_threads(int count) {
+    threads = count;
+  }
+  int get_threads() const {
+    return threads;
+  }
+  size_t frontier_bytes() const {
+    return Base::frontier_bytes() + real_numbers.capacity() * sizeof(real_numbers[0]);
+  }
+  template<typename Config>
+  bag<BoardNode<N, D, M>> pop_batch(SolutionTree<M>& solution, int& nodes_created, Config& config) {
+    bag<BoardNode<N, D, M>> batch;
+    while (static_cast<int>(batch.size()) < threads * leaves_per_thread && !solution.is_full()) {
+      auto board_node = select_leaf(this->root, this->template rebuild_state<Config>(this->root), solution,
+                                    nodes_created, config, true);
+      if (!board_node.has_value()) {
+        break;
+      }
+      auto node = board_node->node;
+      real_numbers.emplace_back(node, make_pair(node->get_proof(), node->get_disproof()));
+      node->set_proof(Node<M>::INFTY);
+      node->set_disproof(Node<M>::INFTY);
+      if (node->has_parent()) {
+        this->update_pn_value(node->get_parent());
+      }
+      batch.push_back(*board_node);
+    }
+    return batch;
+  }
+  void restore(const BoardNode<N, D, M>& board_node) {
+    auto node = board_node.node;
+    auto saved = find_if(begin(real_numbers), end(real_numbers), [&](const auto& entry) {
+      return entry.first == node;
+    });
+    assert(saved != end(real_numbers));
+    node->set_proof(saved->second.first);
+    node->set_disproof(saved->second.second);
+    real_numbers.erase(saved);
+  }
+  void discard(const BoardNode<N, D, M>& board_node) {
+    board_node.node->set_is_eval(false);
+    this->update_pn_value(board_node.node->get_parent());
+  }
+  template<typename F>
+  void run_parallel(int size, F func) {
+    vector<int> index(size);
+    iota(begin(index), end(index), 0);
+    tbb::task_arena arena(threads);
+    arena.execute([&]() {
+      for_each(execution::par, begin(index), end(index), func);
+    });
+  }
+ private:
+  bool is_virtual(const Node<M> *node) const {
+    return node->get_proof() == Node<M>::INFTY && node->get_disproof() == Node<M>::INFTY;
+  }
+
+  template<typename Config>
+  optional<BoardNode<N, D, M>> select_leaf(
+      Node<M>* node, const State<N, D>& state, SolutionTree<M>& solution, int& nodes_created,
+      Config& config, bool or_node) {
+    if (is_virtual(node) || node->is_final()) {
+      return {};
+    }
+    auto board_node = BoardNode<N, D, M>{state, node->get_turn(), node};
+    if (!node->is_eval()) {
+      node->set_is_eval(true);
+      return board_node;
+    }
+    ChildrenBuilder<N, D, Config> builder;
+    auto embryos = builder.get_embryos(board_node);
+    if (!node->has_children()) {
+      builder.build_children(solution, nodes_created, embryos);
+    }
+    auto selected_embryo = or_node ?
+        this->min_embryo(embryos, [](const auto& embryo) { return embryo.proof; }) :
+        this->min_embryo(embryos, [](const auto& embryo) { return embryo.disproof; });
+    if (selected_embryo.child() == nullptr) {
+      return {};
+    }
+    return select_leaf(selected_embryo.child(), selected_embryo.state, solution, nodes_created, config,
+                       !or_node);
+  }
+};
+
+// Depth-first proof-number search. Instead of walking down from the root
+// for every expansion, the search stays below the current node while its
+// proof and disproof numbers are under the thresholds given by its parent.
+// The path is kept as a stack of frames carrying the state of each node,
+// so states are derived incrementally from the embryos. Backing up reuses
+// the proof numbers in the tree, where transpositions are shared through
+// the zobrist chains.
+template<int N, int D, int M>
+class DFPNSearch : public PNSearch<N, D, M> {
+  using Base = PNSearch<N, D, M>;
+  struct Frame {
+    Node<M> *node;
+    State<N, D> state;
+    Turn turn;
+    int proof_threshold, disproof_threshold;
+  };
+  bag<Frame> path;
+  double epsilon = 0.0;
+ public:
+  explicit DFPNSearch(const BoardData<N, D>& data, Node<M> *root) : Base(data, root) {
+  }
+  // The 1+ε trick: the best child may grow up to (1+ε) times the second
+  // best before the search switches, which saves on thrashing.
+  void set_epsilon(double value) {
+    epsilon = value;
+  }
+  size_t frontier_bytes() const {
+    return Base::frontier_bytes() + path.capacity() * sizeof(Frame);
+  }
+  void push_node(BoardNode<N, D, M> board_node) {
+    path.push_back(Frame{board_node.node, board_node.current_state, board_node.turn, infinity, infinity});
+  }
+  template<typename Config>
+  BoardNode<N, D, M> pop_best(SolutionTree<M>& solution, int& nodes_created, Config& config) {
+    while (true) {
+      auto& frame = path.back();
+      auto node = frame.node;
+      if (!node->is_eval()) {
+        node->set_is_eval(true);
+        return BoardNode<N, D, M>{frame.state, frame.turn, node};
+      }
+      // A node that just joined a zobrist chain is left for its parent to
+      // select again, which leads to the first node of the chain.
+      if (path.size() > 1 && (exceeded(frame) || node->get_reason() == Reason::ZOBRIST)) {
+        path.pop_back();
+        continue;
+      }
+      ChildrenBuilder<N, D, Config> builder;
+      auto embryos = builder.get_embryos(BoardNode<N, D, M>{frame.state, frame.turn, node});
+      if (!node->has_children()) {
+        builder.build_children(solution, nodes_created, embryos);
+      }
+      path.push_back(select_child(frame, embryos));
+    }
+  }
+  // After the tree is compacted the descent starts again from the root.
+  void relocate() {
+    while (path.size() > 1) {
+      path.pop_back();
+    }
+  }
+  void reset() {
+    Base::reset();
+    path.clear();
+  }
+ private:
+  constexpr static int infinity = Node<M>::INFTY;
+
+  // An infinite threshold never cuts, so the root only leaves when solved.
+  bool exceeded(const Frame& frame) const {
+    auto node = frame.node;
+    return node->is_final() ||
+        (frame.proof_threshold < infinity && node->get_proof() >= frame.proof_threshold) ||
+        (frame.disproof_threshold < infinity && node->get_disproof() >= frame.disproof_threshold);
+  }
+
+  static int clamp_threshold(int threshold) {
+    return clamp(threshold, 1, infinity);
+  }
+
+  int switch_threshold(int second) const {
+    return second == infinity ? infinity : max(second + 1, static_cast<int>(ceil(second * (1.0 + epsilon))));
+  }
+
+  // As in min_embryo, solved children lose ties: the sums saturate at
+  // infinity, and descending into a solved child makes no progress.
+  Frame select_child(const Frame& frame, bag<Embryo<N, D, M>>& embryos) {
+    bool or_node = frame.turn == Turn::X;
+    auto pluck = [&](const auto& embryo) {
+      return static_cast<int>(or_node ? embryo.proof : embryo.disproof);
+    };
+    auto rank = [&](const auto& embryo) {
+      return make_pair(embryo.child()->is_final(), pluck(embryo));
+    };
+    Embryo<N, D, M> *best = nullptr;
+    int second = infinity;
+    for (auto& embryo : embryos) {
+      if (embryo.child() == nullptr) {
+        continue;
+      }
+      if (best == nullptr || rank(embryo) < rank(*best)) {
+        if (best != nullptr) {
+          second = min(second, pluck(*best));
+        }
+        best = &embryo;
+      } else {
+        second = min(second, pluck(embryo));
+      }
+    }
+    assert(best != nullptr);
+    auto node = frame.node;
+    int proof_threshold, disproof_threshold;
+    if (or_node) {
+      proof_threshold = min(frame.proof_threshold, switch_threshold(second));
+      disproof_threshold = frame.disproof_threshold == infinity ? infinity :
+          frame.disproof_threshold - node->get_disproof() + best->disproof;
+    } else {
+      disproof_threshold = min(frame.disproof_threshold, switch_threshold(second));
+      proof_threshold = frame.proof_threshold == infinity ? infinity :
+          frame.proof_threshold - node->get_proof() + best->proof;
+    }
+    return Frame{best->child(), best->state, best->turn,
+        clamp_threshold(proof_threshold), clamp_threshold(disproof_threshold)};
+  }
+};
+
 #endif